@@ -1,38 +1,254 @@
-#include <xtensor/xnpy.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include "FissionNet.h"
 #include "OverhaulFissionNet.h"
+#include "Json.h"
 
-int main() {
-  OverhaulFission::Settings settings {
-    7, 7, 7,
-    {
-      {1.75, -1, 60, 540, true},
-      {1.75, -1, 75, 432, true},
-      {1.75, -1, 51, 676, true},
-      {1.80, -1, 30, 1620, true},
-      {1.80, -1, 37, 1296, true},
-      {1.80, -1, 25, 2028, true},
-      {1.80, -1, 71, 288, true},
-      {1.80, -1, 89, 230, true},
-      {1.80, -1, 60, 360, true},
-      {1.85, -1, 35, 864, true},
-      {1.85, -1, 44, 690, true},
-      {1.85, -1, 30, 1080, true}
-    },
-    {
-      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-      -1, -1, -1, -1, -1, -1, -1, -1
-    },
-    {0, 0, 0},
-    OverhaulFission::GoalOutput,
-    false, false, true, true
+// Every allocation in the process is counted, including those of training threads started by Opt::step.
+static std::atomic<long long> nAllocations;
+
+void *operator new(std::size_t size) {
+  ++nAllocations;
+  if (void *result = std::malloc(size ? size : 1))
+    return result;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+namespace {
+  using Common::Json;
+  using Clock = std::chrono::steady_clock;
+
+  constexpr unsigned corpusSeed(1), optSeed(1);
+  constexpr int nCorpus(64);
+  constexpr int sizes[] { 5, 7, 9 };
+
+  struct Options {
+    double minSeconds{0.5};
+    std::string filter, output{"benchmark.json"};
   };
-  OverhaulFission::Opt opt(settings);
-  while (true) {
-    opt.stepInteractive();
-    if (opt.needsRedrawBest()) {
-      std::cout << "output: " << opt.getBest().value.output / 16 << std::endl;
-      xt::dump_npy("best.npy", opt.getBest().state);
+
+  class Suite {
+    Options options;
+    Json results;
+  public:
+    Suite(Options options) :options(std::move(options)), results(Json::array()) {}
+
+    // Runs op(i) for i = 0, 1, ... in doubling batches until minSeconds has passed.
+    template<class F>
+    void run(const std::string &name, int nTiles, F op) {
+      if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+        return;
+      op(0);
+      long long nOps{}, nBatch(1), allocations(nAllocations);
+      auto start(Clock::now());
+      double seconds{};
+      while (seconds < options.minSeconds) {
+        for (long long i{}; i < nBatch; ++i)
+          op(nOps + i + 1);
+        nOps += nBatch;
+        nBatch *= 2;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+      }
+      allocations = nAllocations - allocations;
+      double ns(seconds * 1e9 / nOps);
+      std::cout << name << ": " << ns << " ns/op, " << static_cast<double>(allocations) / nOps << " allocs/op" << std::endl;
+      results.push(Json::object()
+        .set("name", name)
+        .set("ops", nOps)
+        .set("seconds", seconds)
+        .set("nsPerOp", ns)
+        .set("opsPerSecond", nOps / seconds)
+        .set("nsPerTile", ns / nTiles)
+        .set("allocationsPerOp", static_cast<double>(allocations) / nOps));
     }
+
+    void write() const {
+      Json document(Json::object());
+      document.set("minSeconds", options.minSeconds).set("benchmarks", results);
+      std::ofstream out(options.output);
+      document.write(out);
+      out << std::endl;
+    }
+  };
+
+  std::string sizeName(int size) {
+    return std::to_string(size) + "x" + std::to_string(size) + "x" + std::to_string(size);
+  }
+
+  Fission::Settings fissionSettings(int size) {
+    Fission::Settings settings {
+      size, size, size,
+      600.0, 120.0,
+      {},
+      {
+        60, 90, 90, 120, 130, 120, 150, 140, 120, 160, 80, 160, 80, 120, 110,
+        150, 3200, 3000, 4800, 4000, 2800, 7000, 6600, 5400, 6400, 2400, 3600, 2600, 3000, 3600
+      },
+      false, true,
+      Fission::GoalPower,
+      false, false, false
+    };
+    std::fill(settings.limit, settings.limit + Fission::Air, -1);
+    return settings;
+  }
+
+  OverhaulFission::Settings overhaulSettings(int size) {
+    OverhaulFission::Settings settings {
+      size, size, size,
+      {
+        {1.75, -1, 60, 540, true},
+        {1.80, -1, 30, 1620, true},
+        {1.85, -1, 44, 690, true},
+        {1.05, -1, 102, 120, false}
+      },
+      {},
+      {-1, -1, -1},
+      OverhaulFission::GoalOutput,
+      true, false, false, false
+    };
+    std::fill(settings.limits, settings.limits + OverhaulFission::Tiles::Air, -1);
+    settings.compute();
+    return settings;
+  }
+
+  // Uniformly random tiles; a third of the corpus is mostly air, like designs early in a rollout.
+  std::vector<xt::xtensor<int, 3>> makeCorpus(int size, int nTileTypes, int air) {
+    std::mt19937 rng(corpusSeed);
+    std::vector<xt::xtensor<int, 3>> corpus;
+    for (int i{}; i < nCorpus; ++i) {
+      auto &state(corpus.emplace_back(xt::empty<int>({size, size, size})));
+      bool sparse(i % 3 == 0);
+      for (auto &tile : state) {
+        if (sparse && std::uniform_int_distribution<>(0, 3)(rng))
+          tile = air;
+        else
+          tile = std::uniform_int_distribution<>(0, nTileTypes - 1)(rng);
+      }
+    }
+    return corpus;
+  }
+
+  void benchmarkFission(Suite &suite, int size) {
+    std::string suffix("/" + sizeName(size));
+    int nTiles(size * size * size);
+    Fission::Settings settings(fissionSettings(size));
+    auto corpus(makeCorpus(size, Fission::Air + 1, Fission::Air));
+
+    Fission::Evaluator evaluator(settings);
+    Fission::Evaluation evaluation;
+    suite.run("fission/evaluate" + suffix, nTiles, [&](long long i) {
+      evaluator.run(corpus[i % nCorpus], evaluation);
+    });
+
+    Fission::Opt opt(settings, false, optSeed);
+    Fission::Net net(opt);
+    std::vector<Fission::Sample> samples(nCorpus);
+    for (int i{}; i < nCorpus; ++i) {
+      auto &sample(samples[i]);
+      sample.state = corpus[i];
+      std::fill(sample.tileCounts, sample.tileCounts + Fission::Air + 1, 0);
+      for (int tile : sample.state)
+        ++sample.tileCounts[tile];
+      evaluator.run(sample.state, sample.value);
+    }
+    net.newTrajectory();
+    for (auto &sample : samples)
+      net.appendTrajectory(sample);
+    net.finishTrajectory(1.0);
+    suite.run("fission/train" + suffix, nTiles, [&](long long) {
+      net.train();
+    });
+    suite.run("fission/infer" + suffix, nTiles, [&](long long i) {
+      net.infer(samples[i % nCorpus]);
+    });
+
+    Fission::Opt stepOpt(settings, true, optSeed);
+    suite.run("fission/step" + suffix, nTiles, [&](long long) {
+      stepOpt.step();
+    });
+  }
+
+  void benchmarkOverhaul(Suite &suite, int size) {
+    using namespace OverhaulFission;
+    std::string suffix("/" + sizeName(size));
+    int nTiles(size * size * size);
+    Settings settings(overhaulSettings(size));
+    auto corpus(makeCorpus(size, Tiles::C0 + static_cast<int>(settings.cellTypes.size()), Tiles::Air));
+
+    for (bool shieldOn : {false, true}) {
+      Evaluation evaluation;
+      evaluation.initialize(settings, shieldOn);
+      suite.run(std::string("overhaul/evaluate-shield-") + (shieldOn ? "on" : "off") + suffix, nTiles, [&](long long i) {
+        evaluation.run(corpus[i % nCorpus]);
+      });
+    }
+
+    Opt opt(settings, optSeed);
+    Net net(opt);
+    std::vector<Sample> samples(nCorpus);
+    for (int i{}; i < nCorpus; ++i) {
+      auto &sample(samples[i]);
+      sample.state = corpus[i];
+      std::fill(sample.tileCounts, sample.tileCounts + Tiles::C0, 0);
+      for (int tile : sample.state)
+        if (tile < Tiles::C0)
+          ++sample.tileCounts[tile];
+      sample.value.initialize(settings, false);
+      sample.value.run(sample.state);
+    }
+    net.newTrajectory();
+    for (auto &sample : samples)
+      net.appendTrajectory(net.extractFeatures(sample));
+    net.finishTrajectory(1.0);
+    suite.run("overhaul/train" + suffix, nTiles, [&](long long) {
+      net.train();
+    });
+    suite.run("overhaul/infer" + suffix, nTiles, [&](long long i) {
+      net.infer(samples[i % nCorpus]);
+    });
+
+    Settings stepSettings(settings);
+    Opt stepOpt(stepSettings, optSeed);
+    suite.run("overhaul/step" + suffix, nTiles, [&](long long) {
+      stepOpt.step();
+    });
+  }
+
+  int usage() {
+    std::cerr << "usage: FissionBenchmark [--min-seconds S] [--filter substring] [--output benchmark.json]" << std::endl;
+    return 2;
+  }
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i(1); i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--min-seconds") && i + 1 < argc)
+      options.minSeconds = std::atof(argv[++i]);
+    else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+      options.filter = argv[++i];
+    else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+      options.output = argv[++i];
+    else
+      return usage();
+  }
+  Suite suite(options);
+  for (int size : sizes) {
+    benchmarkFission(suite, size);
+    benchmarkOverhaul(suite, size);
   }
+  suite.write();
 }
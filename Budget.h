@@ -0,0 +1,87 @@
+#ifndef _BUDGET_H_
+#define _BUDGET_H_
+#include <atomic>
+#include <chrono>
+
+namespace Common {
+  // Lets another thread stop a run; checked between steps.
+  class CancellationToken {
+    std::atomic<bool> cancelled{};
+  public:
+    void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+  };
+
+  // Limits of zero are unlimited; a run stops at whichever it reaches first. Counts are relative to the start of the run.
+  struct Budget {
+    double seconds{};
+    long long steps{}, evaluations{};
+    // Stop once the best design's raw fitness reaches targetFitness.
+    bool hasTarget{};
+    double targetFitness{};
+    // Stop after this long without improving the best design.
+    long long plateauSteps{}, plateauEvaluations{};
+    double plateauSeconds{};
+    const CancellationToken *token{};
+  };
+
+  enum class StopReason { Cancelled, Target, Steps, Evaluations, Plateau, Time };
+
+  constexpr const char *stopReasonNames[] { "cancelled", "target", "steps", "evaluations", "plateau", "time" };
+
+  inline const char *getStopReasonName(StopReason reason) {
+    return stopReasonNames[static_cast<int>(reason)];
+  }
+
+  // Checks a budget after each step of a run. The clock is only read when the budget has a time limit.
+  class BudgetTracker {
+    using Clock = std::chrono::steady_clock;
+    const Budget &budget;
+    Clock::time_point start, improvedAt;
+    long long startSteps, startEvaluations, lastImprovement;
+    // Where the current plateau started: the last improvement, or the start of the run if there was none since.
+    long long stepsAtImprovement, evaluationsAtImprovement;
+    bool isTimed;
+  public:
+    BudgetTracker(const Budget &budget, long long nSteps, long long nEvaluations, long long lastImprovement)
+      :budget(budget), startSteps(nSteps), startEvaluations(nEvaluations),
+      lastImprovement(lastImprovement), stepsAtImprovement(nSteps), evaluationsAtImprovement(nEvaluations),
+      isTimed(budget.seconds > 0.0 || budget.plateauSeconds > 0.0) {
+      if (isTimed)
+        start = improvedAt = Clock::now();
+    }
+
+    // Returns true and sets reason when the run has to stop.
+    // lastImprovement is the step of the last improvement of the best design, as the optimizers report it.
+    bool check(long long nSteps, long long nEvaluations, long long lastImprovement, double bestFitness, StopReason &reason) {
+      Clock::time_point now;
+      if (isTimed)
+        now = Clock::now();
+      if (lastImprovement != this->lastImprovement) {
+        this->lastImprovement = lastImprovement;
+        stepsAtImprovement = lastImprovement;
+        evaluationsAtImprovement = nEvaluations;
+        improvedAt = now;
+      }
+      if (budget.token && budget.token->isCancelled())
+        reason = StopReason::Cancelled;
+      else if (budget.hasTarget && bestFitness >= budget.targetFitness)
+        reason = StopReason::Target;
+      else if (budget.steps && nSteps - startSteps >= budget.steps)
+        reason = StopReason::Steps;
+      else if (budget.evaluations && nEvaluations - startEvaluations >= budget.evaluations)
+        reason = StopReason::Evaluations;
+      else if ((budget.plateauSteps && nSteps - stepsAtImprovement >= budget.plateauSteps)
+        || (budget.plateauEvaluations && nEvaluations - evaluationsAtImprovement >= budget.plateauEvaluations)
+        || (budget.plateauSeconds > 0.0 && std::chrono::duration<double>(now - improvedAt).count() >= budget.plateauSeconds))
+        reason = StopReason::Plateau;
+      else if (budget.seconds > 0.0 && std::chrono::duration<double>(now - start).count() >= budget.seconds)
+        reason = StopReason::Time;
+      else
+        return false;
+      return true;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef _COUNTERS_H_
+#define _COUNTERS_H_
+#include <chrono>
+#include "Trace.h"
+
+namespace Common {
+  using Clock = std::chrono::steady_clock;
+
+  // Phases of one evaluation. The legacy evaluator has no flux or clusters and only fills setup, heat sinks and stats.
+  enum {
+    PhaseSetup,
+    PhaseFlux,
+    PhaseHeatSinks,
+    PhaseClusters,
+    PhaseSparsity,
+    PhaseStats,
+    nPhases
+  };
+
+  constexpr const char *phaseNames[nPhases] { "setup", "flux", "heatSinks", "clusters", "sparsity", "stats" };
+
+  struct PhaseProfile {
+    double seconds[nPhases]{};
+    long long nRuns{};
+  };
+
+  // Adds the time spent in each phase of one evaluation to a profile, and to the trace when this evaluation is sampled.
+  // Does nothing with a null profile outside of a sampled trace scope.
+  class PhaseTimer {
+    PhaseProfile *profile;
+    Clock::time_point start;
+    double traceStart;
+    int phase;
+    bool tracing;
+  public:
+    explicit PhaseTimer(PhaseProfile *profile) :profile(profile), phase(PhaseSetup), tracing(isTraceSampled()) {
+      if (profile)
+        start = Clock::now();
+      if (tracing)
+        traceStart = getTraceTime();
+    }
+
+    void next(int newPhase) {
+      if (profile) {
+        auto now(Clock::now());
+        profile->seconds[phase] += std::chrono::duration<double>(now - start).count();
+        start = now;
+      }
+      if (tracing) {
+        double now(getTraceTime());
+        addTraceEvent(phaseNames[phase], traceStart, now);
+        traceStart = now;
+      }
+      phase = newPhase;
+    }
+
+    ~PhaseTimer() {
+      if (!profile && !tracing)
+        return;
+      next(phase);
+      if (profile)
+        ++profile->nRuns;
+    }
+  };
+
+  // Adds the lifetime of the scope to *target; does nothing for a null target.
+  class ScopedTimer {
+    double *target;
+    Clock::time_point start;
+  public:
+    explicit ScopedTimer(double *target) :target(target) {
+      if (target)
+        start = Clock::now();
+    }
+
+    ~ScopedTimer() {
+      if (target)
+        *target += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+  };
+
+  // Event counts are always kept since they cost an increment each.
+  // Timings need profiling to be switched on because every sample reads the clock.
+  struct Counters {
+    double seconds{};
+    long long nSteps{}, nEvaluations{}, nProposals{}, nAccepted{}, nInferences{}, nTrainIterations{};
+    // Rows offered to the replay pool and how many of them were already stored.
+    long long nPoolAppends{}, nPoolDuplicates{};
+    int poolSize{};
+    double rolloutSeconds{}, trainSeconds{}, inferSeconds{};
+    PhaseProfile phases;
+
+    double getEvaluationsPerSecond() const { return seconds > 0.0 ? nEvaluations / seconds : 0.0; }
+    double getAcceptanceRate() const { return nProposals ? static_cast<double>(nAccepted) / nProposals : 0.0; }
+    double getPoolHitRate() const { return nPoolAppends ? static_cast<double>(nPoolDuplicates) / nPoolAppends : 0.0; }
+  };
+}
+
+#endif
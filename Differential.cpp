@@ -0,0 +1,438 @@
+#include <algorithm>
+#include <cstdio>
+#include <optional>
+#include <xtensor/xview.hpp>
+#include "Driver.h"
+#include "Differential.h"
+
+namespace Differential {
+  namespace {
+    using Common::Json;
+
+    // Limits on shrinking, in evaluations of the failing case.
+    constexpr int maxShrinkAttempts(20000);
+
+    // An evaluation flattened to (field, value) pairs; doubles are printed exactly.
+    class Fields {
+      std::vector<std::pair<std::string, std::string>> items;
+    public:
+      void add(const std::string &name, const std::string &value) { items.emplace_back(name, value); }
+      void add(const std::string &name, const char *value) { add(name, std::string(value)); }
+      void add(const std::string &name, bool value) { add(name, value ? "true" : "false"); }
+      void add(const std::string &name, int value) { add(name, std::to_string(value)); }
+      void add(const std::string &name, double value) {
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "%a", value);
+        add(name, buffer);
+      }
+      template<class Coord>
+      void addCoords(const std::string &name, std::vector<Coord> coords) {
+        // Only membership matters for coordinate lists.
+        std::sort(coords.begin(), coords.end());
+        std::string value;
+        for (auto &[x, y, z] : coords)
+          value += "(" + std::to_string(x) + "," + std::to_string(y) + "," + std::to_string(z) + ")";
+        add(name, value);
+      }
+      const std::vector<std::pair<std::string, std::string>> &get() const { return items; }
+    };
+
+    struct Mismatch {
+      int index;
+      std::string field, reference, candidate;
+    };
+
+    std::optional<Mismatch> compare(int index, const Fields &reference, const Fields &candidate) {
+      auto &a(reference.get()), &b(candidate.get());
+      for (std::size_t i{}; i < std::min(a.size(), b.size()); ++i)
+        if (a[i] != b[i])
+          return Mismatch{index, a[i].first + (a[i].first == b[i].first ? "" : " / " + b[i].first), a[i].second, b[i].second};
+      if (a.size() != b.size())
+        return Mismatch{index, "field count", std::to_string(a.size()), std::to_string(b.size())};
+      return std::nullopt;
+    }
+
+    Fields flatten(const Fission::Evaluation &x) {
+      Fields result;
+      result.addCoords("invalidTiles", x.invalidTiles);
+      result.add("powerMult", x.powerMult);
+      result.add("heatMult", x.heatMult);
+      result.add("cooling", x.cooling);
+      result.add("breed", x.breed);
+      result.add("heat", x.heat);
+      result.add("netHeat", x.netHeat);
+      result.add("dutyCycle", x.dutyCycle);
+      result.add("avgMult", x.avgMult);
+      result.add("power", x.power);
+      result.add("avgPower", x.avgPower);
+      result.add("avgBreed", x.avgBreed);
+      result.add("efficiency", x.efficiency);
+      return result;
+    }
+
+    // Covers every field that Evaluation::run writes; fields left unset for some tiles are only compared where they are set.
+    Fields flatten(const OverhaulFission::Evaluation &x) {
+      using namespace OverhaulFission;
+      Fields result;
+      result.add("rawEfficiency", x.rawEfficiency);
+      result.add("efficiency", x.efficiency);
+      result.add("rawOutput", x.rawOutput);
+      result.add("output", x.output);
+      result.add("density", x.density);
+      result.add("sparsityPenalty", x.sparsityPenalty);
+      result.add("nFunctionalBlocks", x.nFunctionalBlocks);
+      result.add("totalPositiveNetHeat", x.totalPositiveNetHeat);
+      result.add("irradiatorFlux", x.irradiatorFlux);
+      result.add("nActiveCells", x.nActiveCells);
+      result.add("totalRawFlux", x.totalRawFlux);
+      result.add("maxCellFlux", x.maxCellFlux);
+      result.add("shieldOn", x.shieldOn);
+      result.addCoords("cells", x.cells);
+      result.addCoords("tier1s", x.tier1s);
+      result.addCoords("tier2s", x.tier2s);
+      result.addCoords("tier3s", x.tier3s);
+      result.addCoords("shields", x.shields);
+      result.addCoords("irradiators", x.irradiators);
+      result.addCoords("conductors", x.conductors);
+      result.addCoords("fluxRoots", x.fluxRoots);
+      for (std::size_t i{}; i < x.nFunctionalTiles.size(); ++i)
+        result.add("nFunctionalTiles[" + std::to_string(i) + "]", x.nFunctionalTiles[i]);
+      for (std::size_t i{}; i < x.clusters.size(); ++i) {
+        auto &cluster(x.clusters[i]);
+        std::string prefix("clusters[" + std::to_string(i) + "].");
+        result.addCoords(prefix + "tiles", cluster.tiles);
+        result.add(prefix + "rawOutput", cluster.rawOutput);
+        result.add(prefix + "coolingPenaltyMult", cluster.coolingPenaltyMult);
+        result.add(prefix + "output", cluster.output);
+        result.add(prefix + "rawEfficiency", cluster.rawEfficiency);
+        result.add(prefix + "efficiency", cluster.efficiency);
+        result.add(prefix + "heat", cluster.heat);
+        result.add(prefix + "cooling", cluster.cooling);
+        result.add(prefix + "netHeat", cluster.netHeat);
+        result.add(prefix + "hasCasingConnection", cluster.hasCasingConnection);
+      }
+      for (int i{}; i < static_cast<int>(x.tiles.shape(0)); ++i) {
+        for (int j{}; j < static_cast<int>(x.tiles.shape(1)); ++j) {
+          for (int k{}; k < static_cast<int>(x.tiles.shape(2)); ++k) {
+            std::string prefix("tiles(" + std::to_string(i) + "," + std::to_string(j) + "," + std::to_string(k) + ").");
+            auto &tile(x.tiles(i, j, k));
+            result.add(prefix + "kind", static_cast<int>(tile.index()));
+            std::visit(Overload {
+              [&](const Air &) {},
+              [&](const Cell &cell) {
+                result.add(prefix + "fuel", static_cast<int>(cell.fuel - x.settings->fuels.data()));
+                result.add(prefix + "neutronSource", cell.neutronSource);
+                result.add(prefix + "isNeutronSourceBlocked", cell.isNeutronSourceBlocked);
+                result.add(prefix + "isExcludedFromFluxRoots", cell.isExcludedFromFluxRoots);
+                result.add(prefix + "isActive", cell.isActive);
+                result.add(prefix + "flux", cell.flux);
+                result.add(prefix + "heatMult", cell.heatMult);
+                result.add(prefix + "positionalEfficiency", cell.positionalEfficiency);
+                result.add(prefix + "cluster", cell.cluster);
+                if (cell.cluster >= 0) {
+                  result.add(prefix + "fluxEfficiency", cell.fluxEfficiency);
+                  result.add(prefix + "efficiency", cell.efficiency);
+                }
+              },
+              [&](const Moderator &moderator) {
+                result.add(prefix + "type", moderator.type);
+                result.add(prefix + "isActive", moderator.isActive);
+                result.add(prefix + "isFunctional", moderator.isFunctional);
+              },
+              [&](const Reflector &reflector) {
+                result.add(prefix + "type", reflector.type);
+                result.add(prefix + "isActive", reflector.isActive);
+              },
+              [&](const Shield &shield) {
+                result.add(prefix + "flux", shield.flux);
+                result.add(prefix + "cluster", shield.cluster);
+              },
+              [&](const Irradiator &irradiator) {
+                result.add(prefix + "flux", irradiator.flux);
+                result.add(prefix + "cluster", irradiator.cluster);
+              },
+              [&](const Conductor &conductor) {
+                result.add(prefix + "cluster", conductor.cluster);
+              },
+              [&](const HeatSink &heatSink) {
+                result.add(prefix + "type", heatSink.type);
+                result.add(prefix + "isActive", heatSink.isActive);
+                result.add(prefix + "cluster", heatSink.cluster);
+              }
+            }, tile);
+          }
+        }
+      }
+      return result;
+    }
+
+    template<class Settings>
+    int mirror(const Settings &settings, int axis, int i) {
+      bool sym(axis == 0 ? settings.symX : axis == 1 ? settings.symY : settings.symZ);
+      int size(axis == 0 ? settings.sizeX : axis == 1 ? settings.sizeY : settings.sizeZ);
+      return sym ? size - 1 - i : i;
+    }
+
+    template<class Settings>
+    void setWithSym(const Settings &settings, State &state, int x, int y, int z, int tile) {
+      for (int mx : {x, mirror(settings, 0, x)})
+        for (int my : {y, mirror(settings, 1, y)})
+          for (int mz : {z, mirror(settings, 2, z)})
+            state(mx, my, mz) = tile;
+    }
+
+    // A random symmetric state followed by single-tile mutations of it. Half of the states are mostly air.
+    template<class Settings>
+    std::vector<State> randomChain(std::mt19937 &rng, const Settings &settings, int nTileTypes, int air, int nMutations) {
+      std::uniform_int_distribution<> tileDist(0, nTileTypes - 1);
+      bool sparse(std::uniform_int_distribution<>(0, 1)(rng));
+      auto randomTile([&] {
+        return sparse && std::uniform_int_distribution<>(0, 3)(rng) ? air : tileDist(rng);
+      });
+      std::vector<State> result;
+      State state(xt::empty<int>({settings.sizeX, settings.sizeY, settings.sizeZ}));
+      for (int x{}; x < settings.sizeX; ++x)
+        for (int y{}; y < settings.sizeY; ++y)
+          for (int z{}; z < settings.sizeZ; ++z)
+            if (x <= mirror(settings, 0, x) && y <= mirror(settings, 1, y) && z <= mirror(settings, 2, z))
+              setWithSym(settings, state, x, y, z, randomTile());
+      result.emplace_back(state);
+      for (int i{}; i < nMutations; ++i) {
+        setWithSym(settings, state,
+          std::uniform_int_distribution<>(0, settings.sizeX - 1)(rng),
+          std::uniform_int_distribution<>(0, settings.sizeY - 1)(rng),
+          std::uniform_int_distribution<>(0, settings.sizeZ - 1)(rng), randomTile());
+        result.emplace_back(state);
+      }
+      return result;
+    }
+
+    template<class Settings>
+    void randomShape(std::mt19937 &rng, Settings &settings, int maxSize) {
+      std::uniform_int_distribution<> sizeDist(1, maxSize);
+      std::bernoulli_distribution coin;
+      settings.sizeX = sizeDist(rng);
+      settings.sizeY = sizeDist(rng);
+      settings.sizeZ = sizeDist(rng);
+      settings.symX = coin(rng);
+      settings.symY = coin(rng);
+      settings.symZ = coin(rng);
+    }
+
+    Fission::Settings randomFissionSettings(std::mt19937 &rng, int maxSize) {
+      static constexpr double ratePresets[][Fission::Cell] {
+        {
+          60, 90, 90, 120, 130, 120, 150, 140, 120, 160, 80, 160, 80, 120, 110,
+          150, 3200, 3000, 4800, 4000, 2800, 7000, 6600, 5400, 6400, 2400, 3600, 2600, 3000, 3600
+        }, {
+          20, 80, 80, 120, 120, 100, 120, 120, 140, 140, 60, 140, 60, 80, 100,
+          50, 1000, 1500, 1750, 2000, 2250, 3500, 3300, 2750, 3250, 1700, 2750, 1125, 1250, 2000
+        }
+      };
+      Fission::Settings result;
+      randomShape(rng, result, maxSize);
+      result.fuelBasePower = std::uniform_real_distribution<>(50.0, 1500.0)(rng);
+      result.fuelBaseHeat = std::uniform_real_distribution<>(10.0, 500.0)(rng);
+      std::fill(result.limit, result.limit + Fission::Air, -1);
+      auto &rates(ratePresets[std::uniform_int_distribution<>(0, 1)(rng)]);
+      std::copy(rates, rates + Fission::Cell, result.coolingRates);
+      std::bernoulli_distribution coin;
+      result.ensureActiveCoolerAccessible = coin(rng);
+      result.ensureHeatNeutral = coin(rng);
+      result.goal = std::uniform_int_distribution<>(Fission::GoalPower, Fission::GoalEfficiency)(rng);
+      return result;
+    }
+
+    OverhaulFission::Settings randomOverhaulSettings(std::mt19937 &rng, int maxSize) {
+      OverhaulFission::Settings result;
+      randomShape(rng, result, maxSize);
+      std::bernoulli_distribution coin;
+      int nFuels(std::uniform_int_distribution<>(1, 4)(rng));
+      for (int i{}; i < nFuels; ++i) {
+        auto &fuel(result.fuels.emplace_back());
+        fuel.efficiency = std::uniform_int_distribution<>(100, 190)(rng) / 100.0;
+        fuel.limit = -1;
+        fuel.criticality = std::uniform_int_distribution<>(20, 120)(rng);
+        fuel.heat = std::uniform_int_distribution<>(50, 2100)(rng);
+        fuel.selfPriming = coin(rng);
+      }
+      std::fill(result.limits, result.limits + OverhaulFission::Tiles::Air, -1);
+      std::fill(result.sourceLimits, result.sourceLimits + 3, -1);
+      result.goal = std::uniform_int_distribution<>(OverhaulFission::GoalOutput, OverhaulFission::GoalIrradiation)(rng);
+      result.controllable = coin(rng);
+      result.compute();
+      return result;
+    }
+
+    // Drops layers, earlier states and tiles for as long as the case keeps failing.
+    template<class Settings, class Fails>
+    void shrink(Settings &settings, std::vector<State> &chain, int air, Fails fails) {
+      int nAttempts{};
+      auto attempt([&](const Settings &newSettings, const std::vector<State> &newChain) {
+        if (nAttempts >= maxShrinkAttempts)
+          return false;
+        ++nAttempts;
+        if (!fails(newSettings, newChain))
+          return false;
+        settings = newSettings;
+        chain = newChain;
+        return true;
+      });
+      for (bool progress(true); progress && nAttempts < maxShrinkAttempts;) {
+        progress = false;
+        for (int axis{}; axis < 3; ++axis) {
+          for (bool front : {false, true}) {
+            int size(chain[0].shape(axis));
+            if (size <= 1)
+              continue;
+            Settings newSettings(settings);
+            (axis == 0 ? newSettings.sizeX : axis == 1 ? newSettings.sizeY : newSettings.sizeZ) = size - 1;
+            // Cropping breaks the mirror symmetry of the state, so the flag goes too.
+            (axis == 0 ? newSettings.symX : axis == 1 ? newSettings.symY : newSettings.symZ) = false;
+            std::vector<State> newChain;
+            for (auto &state : chain) {
+              auto range(front ? xt::range(1, size) : xt::range(0, size - 1));
+              newChain.emplace_back(axis == 0 ? State(xt::view(state, range, xt::all(), xt::all()))
+                : axis == 1 ? State(xt::view(state, xt::all(), range, xt::all()))
+                : State(xt::view(state, xt::all(), xt::all(), range)));
+            }
+            progress |= attempt(newSettings, newChain);
+          }
+        }
+        for (std::size_t i{}; i + 1 < chain.size();) {
+          std::vector<State> newChain(chain);
+          newChain.erase(newChain.begin() + i);
+          if (attempt(settings, newChain))
+            progress = true;
+          else
+            ++i;
+        }
+        for (std::size_t i{}; i < chain.size(); ++i) {
+          for (std::size_t j{}; j < chain[i].size(); ++j) {
+            if (chain[i].data()[j] == air)
+              continue;
+            std::vector<State> newChain(chain);
+            newChain[i].data()[j] = air;
+            progress |= attempt(settings, newChain);
+          }
+        }
+      }
+    }
+
+    Json stateToJson(const State &state) {
+      Json result(Json::array());
+      for (int tile : state)
+        result.push(tile);
+      return result;
+    }
+
+    template<class Settings>
+    Json report(const std::string &backend, const Settings &settings, const std::vector<State> &chain,
+      const Mismatch &mismatch, Json settingsJson) {
+      Json states(Json::array());
+      for (auto &state : chain)
+        states.push(stateToJson(state));
+      Json shape(Json::array());
+      shape.push(settings.sizeX).push(settings.sizeY).push(settings.sizeZ);
+      return Json::object()
+        .set("backend", backend)
+        .set("settings", std::move(settingsJson))
+        .set("shape", std::move(shape))
+        .set("states", std::move(states))
+        .set("field", mismatch.field)
+        .set("reference", mismatch.reference)
+        .set("candidate", mismatch.candidate);
+    }
+  }
+
+  const std::vector<FissionBackend> &getFissionBackends() {
+    static const std::vector<FissionBackend> backends {
+      {"reused", [](const Fission::Settings &settings) -> FissionRun {
+        auto evaluator(std::make_shared<Fission::Evaluator>(settings));
+        return [evaluator](const State &state, Fission::Evaluation &result) { evaluator->run(state, result); };
+      }}
+    };
+    return backends;
+  }
+
+  const std::vector<OverhaulBackend> &getOverhaulBackends() {
+    static const std::vector<OverhaulBackend> backends {
+      {"reused", [](const OverhaulFission::Settings &settings, bool shieldOn) -> OverhaulRun {
+        auto evaluation(std::make_shared<OverhaulFission::Evaluation>());
+        evaluation->initialize(settings, shieldOn);
+        return [evaluation](const State &state, OverhaulFission::Evaluation &result) {
+          evaluation->run(state);
+          result = *evaluation;
+        };
+      }}
+    };
+    return backends;
+  }
+
+  Json checkFission(const FissionBackend &backend, const Options &options) {
+    std::mt19937 rng(options.seed);
+    auto firstMismatch([&](const Fission::Settings &settings, const std::vector<State> &chain) -> std::optional<Mismatch> {
+      FissionRun candidate(backend.bind(settings));
+      for (std::size_t i{}; i < chain.size(); ++i) {
+        Fission::Evaluation expected, actual;
+        Fission::Evaluator(settings).run(chain[i], expected);
+        candidate(chain[i], actual);
+        if (auto mismatch = compare(static_cast<int>(i), flatten(expected), flatten(actual)))
+          return mismatch;
+      }
+      return std::nullopt;
+    });
+    for (int i{}; i < options.nCases; ++i) {
+      Fission::Settings settings(randomFissionSettings(rng, options.maxSize));
+      std::vector<State> chain(randomChain(rng, settings, Fission::Air + 1, Fission::Air, options.nMutations));
+      auto mismatch(firstMismatch(settings, chain));
+      if (!mismatch)
+        continue;
+      chain.resize(mismatch->index + 1);
+      shrink(settings, chain, Fission::Air, [&](const Fission::Settings &s, const std::vector<State> &c) {
+        return firstMismatch(s, c).has_value();
+      });
+      if (auto shrunk = firstMismatch(settings, chain))
+        mismatch = shrunk;
+      return report(backend.name, settings, chain, *mismatch, Driver::settingsToJson(settings));
+    }
+    return {};
+  }
+
+  Json checkOverhaul(const OverhaulBackend &backend, const Options &options) {
+    using namespace OverhaulFission;
+    std::mt19937 rng(options.seed);
+    bool shieldOn{};
+    auto firstMismatch([&](const Settings &settings, const std::vector<State> &chain) -> std::optional<Mismatch> {
+      OverhaulRun candidate(backend.bind(settings, shieldOn));
+      for (std::size_t i{}; i < chain.size(); ++i) {
+        Evaluation expected, actual;
+        expected.initialize(settings, shieldOn);
+        expected.run(chain[i]);
+        candidate(chain[i], actual);
+        if (auto mismatch = compare(static_cast<int>(i), flatten(expected), flatten(actual)))
+          return mismatch;
+      }
+      return std::nullopt;
+    });
+    for (int i{}; i < options.nCases; ++i) {
+      Settings settings(randomOverhaulSettings(rng, options.maxSize));
+      shieldOn = settings.controllable && std::bernoulli_distribution()(rng);
+      int nTileTypes(Tiles::C0 + static_cast<int>(settings.cellTypes.size()));
+      std::vector<State> chain(randomChain(rng, settings, nTileTypes, Tiles::Air, options.nMutations));
+      auto mismatch(firstMismatch(settings, chain));
+      if (!mismatch)
+        continue;
+      chain.resize(mismatch->index + 1);
+      shrink(settings, chain, Tiles::Air, [&](const Settings &s, const std::vector<State> &c) {
+        return firstMismatch(s, c).has_value();
+      });
+      if (auto shrunk = firstMismatch(settings, chain))
+        mismatch = shrunk;
+      Json result(report(backend.name, settings, chain, *mismatch, Driver::settingsToJson(settings)));
+      result.set("shieldOn", shieldOn);
+      return result;
+    }
+    return {};
+  }
+}
@@ -0,0 +1,41 @@
+#ifndef _DIFFERENTIAL_H_
+#define _DIFFERENTIAL_H_
+#include <functional>
+#include "Json.h"
+#include "Fission.h"
+#include "OverhaulFission.h"
+
+// Differential checking of evaluator backends against the reference evaluators.
+// The reference constructs a fresh evaluator for every state. A backend is bound once per case and then evaluates
+//   a chain of random mutations, the way the optimizer drives it, so state carried between calls is exercised too.
+namespace Differential {
+  using State = xt::xtensor<int, 3>;
+  using FissionRun = std::function<void(const State &, Fission::Evaluation &)>;
+  using OverhaulRun = std::function<void(const State &, OverhaulFission::Evaluation &)>;
+
+  struct FissionBackend {
+    std::string name;
+    std::function<FissionRun(const Fission::Settings &)> bind;
+  };
+
+  struct OverhaulBackend {
+    std::string name;
+    std::function<OverhaulRun(const OverhaulFission::Settings &, bool shieldOn)> bind;
+  };
+
+  // "reused" keeps one evaluator across calls, as Opt does; faster backends register here as they are added.
+  const std::vector<FissionBackend> &getFissionBackends();
+  const std::vector<OverhaulBackend> &getOverhaulBackends();
+
+  struct Options {
+    int nCases{1000}, nMutations{32}, maxSize{9};
+    unsigned seed{1};
+  };
+
+  // Returns null if every case matched, or else a report with the shrunk reproducer
+  //   (settings, the chain of states and the first mismatching field).
+  Common::Json checkFission(const FissionBackend &backend, const Options &options);
+  Common::Json checkOverhaul(const OverhaulBackend &backend, const Options &options);
+}
+
+#endif
@@ -0,0 +1,674 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include "FissionNet.h"
+#include "OverhaulFissionNet.h"
+#include "Driver.h"
+#include "ExactFission.h"
+#include "Log.h"
+#include "Planner.h"
+#include "ResultStore.h"
+#include "Scheduler.h"
+#include "Snapshot.h"
+
+namespace Driver {
+  namespace {
+    using Common::Json;
+
+    template<class T, std::size_t N>
+    void parseArray(const Json &json, const char *key, T (&out)[N]) {
+      auto &elements(json[key].asArray());
+      if (elements.size() != N)
+        throw std::runtime_error(std::string("settings: \"") + key + "\" needs " + std::to_string(N) + " entries");
+      for (std::size_t i{}; i < N; ++i) {
+        if constexpr (std::is_same_v<T, int>)
+          out[i] = elements[i].asInt();
+        else
+          out[i] = elements[i].asNumber();
+      }
+    }
+
+    bool parseOptionalBool(const Json &json, const char *key) {
+      const Json *value(json.find(key));
+      return value && value->asBool();
+    }
+
+    int parseGoal(const Json &json, std::initializer_list<const char *> names) {
+      if (json.getType() == Json::Type::Number)
+        return json.asInt();
+      int i{};
+      for (auto name : names) {
+        if (json.asString() == name)
+          return i;
+        ++i;
+      }
+      throw std::runtime_error("settings: unknown goal \"" + json.asString() + "\"");
+    }
+
+    template<class T, std::size_t N>
+    Json arrayToJson(const T (&x)[N]) {
+      Json result(Json::array());
+      for (auto &i : x)
+        result.push(i);
+      return result;
+    }
+
+    // A job's own member, falling back to the defaults.
+    const Json *lookup(const Json &job, const Json *defaults, const char *key) {
+      if (const Json *value = job.find(key))
+        return value;
+      return defaults ? defaults->find(key) : nullptr;
+    }
+
+    Json stateToJson(const xt::xtensor<int, 3> &state) {
+      Json shape(Json::array()), data(Json::array());
+      for (auto i : state.shape())
+        shape.push(static_cast<int>(i));
+      for (int tile : state)
+        data.push(tile);
+      return Json::object().set("shape", std::move(shape)).set("state", std::move(data));
+    }
+
+    Json bestToJson(const Fission::Sample &best) {
+      Json result(stateToJson(best.state));
+      auto &value(best.value);
+      result.set("power", value.power).set("heat", value.heat).set("cooling", value.cooling)
+        .set("netHeat", value.netHeat).set("dutyCycle", value.dutyCycle).set("avgPower", value.avgPower)
+        .set("avgBreed", value.avgBreed).set("efficiency", value.efficiency);
+      return result;
+    }
+
+    Json bestToJson(const OverhaulFission::Sample &best) {
+      Json result(stateToJson(best.state));
+      auto &value(best.value);
+      result.set("output", value.output).set("efficiency", value.efficiency)
+        .set("irradiatorFlux", value.irradiatorFlux).set("density", value.density)
+        .set("sparsityPenalty", value.sparsityPenalty).set("nActiveCells", value.nActiveCells);
+      return result;
+    }
+
+    Json countersToJson(const Common::Counters &counters, bool profiled) {
+      Json result(Json::object());
+      result.set("nEvaluations", counters.nEvaluations)
+        .set("evaluationsPerSecond", counters.getEvaluationsPerSecond())
+        .set("nProposals", counters.nProposals)
+        .set("acceptanceRate", counters.getAcceptanceRate())
+        .set("nInferences", counters.nInferences)
+        .set("nTrainIterations", counters.nTrainIterations)
+        .set("poolSize", counters.poolSize)
+        .set("poolHitRate", counters.getPoolHitRate());
+      if (profiled) {
+        Json phases(Json::object());
+        for (int i{}; i < Common::nPhases; ++i)
+          phases.set(Common::phaseNames[i], counters.phases.seconds[i]);
+        result.set("rolloutSeconds", counters.rolloutSeconds)
+          .set("trainSeconds", counters.trainSeconds)
+          .set("inferSeconds", counters.inferSeconds)
+          .set("phaseSeconds", std::move(phases));
+      }
+      return result;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    constexpr double sliceSeconds(0.05);
+
+    std::uint64_t getStoreKey(const Job &job) {
+      return job.mode == Mode::Fission ? job.fissionSettings.hash() : job.overhaulSettings.hash();
+    }
+
+    // The store keeps the state bit-packed and the rest of bestToJson's output as text.
+    Common::StoredResult toStored(const Job &job, double fitness, const Json &best) {
+      Common::StoredResult result;
+      result.mode = static_cast<int>(job.mode);
+      result.fitness = fitness;
+      auto &shape(best["shape"].asArray());
+      for (int i{}; i < 3; ++i)
+        result.shape[i] = shape[i].asInt();
+      for (auto &tile : best["state"].asArray())
+        result.state.emplace_back(tile.asInt());
+      Json summary(Json::object());
+      for (auto &[key, value] : best.asObject())
+        if (key != "shape" && key != "state")
+          summary.set(key, value);
+      result.summary = summary.dump();
+      return result;
+    }
+
+    Json fromStored(const Job &job, const Common::StoredResult &stored) {
+      Json shape(Json::array()), state(Json::array());
+      for (int i : stored.shape)
+        shape.push(i);
+      for (int tile : stored.state)
+        state.push(tile);
+      Json best(Json::object());
+      best.set("shape", std::move(shape)).set("state", std::move(state));
+      for (auto &[key, value] : Json::parse(stored.summary).asObject())
+        best.set(key, value);
+      Json result(Json::object());
+      result.set("name", job.name)
+        .set("mode", job.mode == Mode::Fission ? "fission" : "overhaul")
+        .set("seed", static_cast<long long>(job.seed))
+        .set("stopReason", "stored")
+        .set("seconds", 0.0)
+        .set("steps", 0)
+        .set("fitness", stored.fitness)
+        .set("best", std::move(best));
+      return result;
+    }
+
+    // Shared by the islands of one job, which update it under the lock at the end of their runs.
+    struct JobState {
+      const Job &job;
+      std::mutex &printMutex;
+      std::mutex mutex;
+      Clock::time_point start;
+      bool isStarted, isFailed;
+      int nRunning, bestIsland;
+      double bestFitness;
+      std::string error;
+      std::vector<Json> islands;
+      Json best, result;
+      std::unique_ptr<Common::SnapshotWriter<Json>> snapshots;
+      Common::ResultStore *store;
+      xt::xtensor<int, 3> initial;
+      // The best design's tiles, and whether it improved since an island was last started from it.
+      xt::xtensor<int, 3> bestState;
+      bool canSpawn;
+      Clock::time_point improvedAt;
+      // Threads for the replicas of parallel tempering, out of the workers' share of this job's islands.
+      int nTemperingThreads;
+
+      JobState(const Job &job, std::mutex &printMutex, Common::ResultStore *store)
+        :job(job), printMutex(printMutex), isStarted(), isFailed(),
+        nRunning(job.nIslands), bestIsland(-1), bestFitness(), islands(job.nIslands), store(store), initial(job.initial),
+        canSpawn(), nTemperingThreads(1) {
+        if (!job.snapshotFile.empty())
+          snapshots = std::make_unique<Common::SnapshotWriter<Json>>(job.snapshotFile,
+            [](std::ostream &out, const Json &best) { best.write(out); out << std::endl; });
+      }
+
+      // Called once by each island when it stops; the last one assembles the result.
+      void leave() {
+        if (--nRunning)
+          return;
+        if (isFailed) {
+          result = Json::object().set("name", job.name).set("error", error);
+        } else {
+          Json islandResults(Json::array());
+          long long nSteps{};
+          for (auto &island : islands) {
+            nSteps += static_cast<long long>(island["steps"].asNumber());
+            islandResults.push(std::move(island));
+          }
+          result = Json::object();
+          result.set("name", job.name)
+            .set("mode", job.mode == Mode::Fission ? "fission" : "overhaul")
+            .set("seed", static_cast<long long>(job.seed))
+            .set("stopReason", islandResults.asArray()[bestIsland]["stopReason"])
+            .set("seconds", std::chrono::duration<double>(Clock::now() - start).count())
+            .set("steps", nSteps)
+            .set("fitness", bestFitness)
+            .set("bestIsland", bestIsland)
+            .set("islands", std::move(islandResults))
+            .set("best", best);
+          if (store) {
+            try {
+              store->offer(getStoreKey(job), toStored(job, bestFitness, best));
+            } catch (const std::exception &e) {
+              Common::log(Common::LogLevel::Warn, "%s: %s", job.name.c_str(), e.what());
+            }
+          }
+        }
+        std::lock_guard lock(printMutex);
+        if (isFailed)
+          std::cout << job.name << ": failed: " << error << std::endl;
+        else
+          std::cout << job.name << ": stopped by " << result["stopReason"].asString()
+            << " after " << result["steps"].asNumber() << " steps" << std::endl;
+      }
+    };
+
+    // One independent run of a job with its own seed, advanced a slice at a time on whichever worker picks it up.
+    // The job's limits apply to each island on its own, except the deadline, which counts from the job's first slice.
+    // The plateau in seconds counts the island's own slices only, not the time it spends queued.
+    template<class Opt, class Settings>
+    class Island {
+      using Sample = std::decay_t<decltype(std::declval<Opt>().getBest())>;
+      JobState &state;
+      Settings settings;
+      int index;
+      xt::xtensor<int, 3> initial;
+      std::unique_ptr<Opt> opt;
+      double runSeconds, runSecondsAtImprovement;
+      long long evaluationsAtImprovement;
+
+      void start() {
+        auto &job(state.job);
+        unsigned seed(job.seed + index);
+        if constexpr (std::is_same_v<Opt, Fission::Opt>) {
+          opt = std::make_unique<Opt>(settings, job.useNet, initial, seed);
+          opt->setPolish(job.polishSweeps, job.polishSwaps);
+        } else {
+          opt = std::make_unique<Opt>(settings, initial, seed);
+          opt->setTemperingThreads(state.nTemperingThreads);
+        }
+        opt->setProfiling(job.profile);
+        // Islands can't share a replay file, so only the first one gets it.
+        if (!index && !job.replayFile.empty() && !opt->setReplayFile(job.replayFile))
+          Common::log(Common::LogLevel::Warn, "%s: can't map %s, keeping the replay pool in memory", job.name.c_str(), job.replayFile.c_str());
+      }
+
+      // Turns what is left of the job's budget into the budget of the next slice. Returns false if nothing is left.
+      bool plan(Common::Budget &slice, bool &isFinal, Common::StopReason &stopReason) {
+        auto &budget(state.job.budget);
+        auto now(Clock::now());
+        slice = budget;
+        slice.token = nullptr;
+        isFinal = false;
+        if (budget.hasTarget && opt->getBestFitness() >= budget.targetFitness) {
+          stopReason = Common::StopReason::Target;
+          return false;
+        }
+        auto take([&](auto limit, auto used, auto &out, Common::StopReason reason) {
+          if (!limit)
+            return true;
+          out = limit - used;
+          if (out > 0)
+            return true;
+          stopReason = reason;
+          return false;
+        });
+        if (!take(budget.steps, opt->getNSteps(), slice.steps, Common::StopReason::Steps)
+          || !take(budget.evaluations, opt->getNEvaluations(), slice.evaluations, Common::StopReason::Evaluations)
+          || !take(budget.plateauSteps, opt->getNSteps() - opt->getLastImprovement(), slice.plateauSteps, Common::StopReason::Plateau)
+          || !take(budget.plateauEvaluations, opt->getNEvaluations() - evaluationsAtImprovement,
+            slice.plateauEvaluations, Common::StopReason::Plateau)
+          || !take(budget.plateauSeconds, runSeconds - runSecondsAtImprovement,
+            slice.plateauSeconds, Common::StopReason::Plateau))
+          return false;
+        slice.seconds = sliceSeconds;
+        if (budget.seconds > 0.0) {
+          double rest(budget.seconds - std::chrono::duration<double>(now - state.start).count());
+          if (rest <= 0.0) {
+            stopReason = Common::StopReason::Time;
+            return false;
+          }
+          if (rest <= sliceSeconds) {
+            slice.seconds = rest;
+            isFinal = true;
+          }
+        }
+        return true;
+      }
+
+      // Offers the island's best design as the job's best; needs the lock.
+      void publish() {
+        double fitness(opt->getBestFitness());
+        if (state.bestIsland >= 0 && fitness <= state.bestFitness)
+          return;
+        state.bestIsland = index;
+        state.bestFitness = fitness;
+        state.best = bestToJson(opt->getBest());
+        state.bestState = opt->getBest().state;
+        state.canSpawn = true;
+        state.improvedAt = Clock::now();
+        if (state.snapshots)
+          state.snapshots->submit(state.best);
+      }
+
+      void finish(Common::StopReason stopReason) {
+        std::lock_guard lock(state.mutex);
+        publish();
+        state.islands[index] = Json::object()
+          .set("seed", static_cast<long long>(state.job.seed + index))
+          .set("stopReason", Common::getStopReasonName(stopReason))
+          .set("steps", opt->getNSteps())
+          .set("lastImprovement", opt->getLastImprovement())
+          .set("episodes", opt->getNEpisode())
+          .set("fitness", opt->getBestFitness())
+          .set("counters", countersToJson(opt->getCounters(), state.job.profile));
+        opt.reset();
+        state.leave();
+      }
+    public:
+      Island(JobState &state, const Settings &settings, int index, const xt::xtensor<int, 3> &initial)
+        :state(state), settings(settings), index(index), initial(initial),
+        runSeconds(), runSecondsAtImprovement(), evaluationsAtImprovement() {}
+
+      Common::TaskResult operator()() {
+        try {
+          {
+            std::lock_guard lock(state.mutex);
+            if (state.isFailed) {
+              opt.reset();
+              state.leave();
+              return Common::TaskResult::Done;
+            }
+            if (!state.isStarted) {
+              state.isStarted = true;
+              state.start = Clock::now();
+            }
+          }
+          if (!opt)
+            start();
+          Common::Budget slice;
+          Common::StopReason stopReason;
+          bool isFinal;
+          if (!plan(slice, isFinal, stopReason)) {
+            finish(stopReason);
+            return Common::TaskResult::Done;
+          }
+          bool improvedInSlice{};
+          auto sliceStart(Clock::now());
+          auto run(opt->run(slice, [&](const Sample &) {
+            runSecondsAtImprovement = runSeconds + std::chrono::duration<double>(Clock::now() - sliceStart).count();
+            evaluationsAtImprovement = opt->getNEvaluations();
+            improvedInSlice = true;
+          }));
+          runSeconds += std::chrono::duration<double>(Clock::now() - sliceStart).count();
+          if (run.stopReason != Common::StopReason::Time || isFinal) {
+            finish(run.stopReason);
+            return Common::TaskResult::Done;
+          }
+          if (improvedInSlice) {
+            std::lock_guard lock(state.mutex);
+            publish();
+          }
+          // Islands that keep improving stay on their worker; stalled ones queue up behind the rest, where idle workers steal from.
+          return improvedInSlice ? Common::TaskResult::RunNext : Common::TaskResult::RunLater;
+        } catch (const std::exception &e) {
+          opt.reset();
+          std::lock_guard lock(state.mutex);
+          if (!state.isFailed) {
+            state.isFailed = true;
+            state.error = e.what();
+          }
+          state.leave();
+          return Common::TaskResult::Done;
+        }
+      }
+    };
+
+    template<class Opt, class Settings>
+    Common::Task makeIsland(JobState &state, const Settings &settings, int index, const xt::xtensor<int, 3> &initial) {
+      auto island(std::make_shared<Island<Opt, Settings>>(state, settings, index, initial));
+      return [island] { return (*island)(); };
+    }
+
+    Common::Task makeIsland(JobState &state, int index, const xt::xtensor<int, 3> &initial) {
+      if (state.job.mode == Mode::Fission)
+        return makeIsland<Fission::Opt>(state, state.job.fissionSettings, index, initial);
+      return makeIsland<OverhaulFission::Opt>(state, state.job.overhaulSettings, index, initial);
+    }
+
+    // The part of a result that describes the search; a finished search reports "optimal" as its stop reason.
+    Json exactToJson(const Fission::ExactResult &result) {
+      return Json::object()
+        .set("stopReason", result.isOptimal ? "optimal" : Common::getStopReasonName(result.stopReason))
+        .set("steps", result.nNodes)
+        .set("evaluations", result.nEvaluations)
+        .set("fitness", result.fitness);
+    }
+
+    // The exact solver can't be sliced, so it holds its worker until it is done.
+    Common::Task makeExact(JobState &state) {
+      return [&state] {
+        try {
+          {
+            std::lock_guard lock(state.mutex);
+            state.isStarted = true;
+            state.start = Clock::now();
+          }
+          Fission::ExactSolver solver(state.job.fissionSettings);
+          auto result(solver.solve(state.job.budget));
+          std::lock_guard lock(state.mutex);
+          state.bestIsland = 0;
+          state.bestFitness = result.fitness;
+          state.best = bestToJson(result.best);
+          if (state.snapshots)
+            state.snapshots->submit(state.best);
+          state.islands[0] = exactToJson(result);
+          state.leave();
+        } catch (const std::exception &e) {
+          std::lock_guard lock(state.mutex);
+          state.isFailed = true;
+          state.error = e.what();
+          state.leave();
+        }
+        return Common::TaskResult::Done;
+      };
+    }
+  }
+
+  Fission::Settings parseFissionSettings(const Json &json) {
+    Fission::Settings result;
+    result.sizeX = json["sizeX"].asInt();
+    result.sizeY = json["sizeY"].asInt();
+    result.sizeZ = json["sizeZ"].asInt();
+    result.fuelBasePower = json["fuelBasePower"].asNumber();
+    result.fuelBaseHeat = json["fuelBaseHeat"].asNumber();
+    parseArray(json, "limit", result.limit);
+    parseArray(json, "coolingRates", result.coolingRates);
+    result.ensureActiveCoolerAccessible = parseOptionalBool(json, "ensureActiveCoolerAccessible");
+    result.ensureHeatNeutral = parseOptionalBool(json, "ensureHeatNeutral");
+    result.goal = parseGoal(json["goal"], {"power", "breeder", "efficiency"});
+    result.symX = parseOptionalBool(json, "symX");
+    result.symY = parseOptionalBool(json, "symY");
+    result.symZ = parseOptionalBool(json, "symZ");
+    return result;
+  }
+
+  OverhaulFission::Settings parseOverhaulSettings(const Json &json) {
+    OverhaulFission::Settings result;
+    result.sizeX = json["sizeX"].asInt();
+    result.sizeY = json["sizeY"].asInt();
+    result.sizeZ = json["sizeZ"].asInt();
+    for (auto &fuelJson : json["fuels"].asArray()) {
+      auto &fuel(result.fuels.emplace_back());
+      fuel.efficiency = fuelJson["efficiency"].asNumber();
+      fuel.limit = fuelJson["limit"].asInt();
+      fuel.criticality = fuelJson["criticality"].asInt();
+      fuel.heat = fuelJson["heat"].asInt();
+      fuel.selfPriming = parseOptionalBool(fuelJson, "selfPriming");
+    }
+    if (result.fuels.empty())
+      throw std::runtime_error("settings: no fuels");
+    parseArray(json, "limits", result.limits);
+    parseArray(json, "sourceLimits", result.sourceLimits);
+    result.goal = parseGoal(json["goal"], {"output", "fuelUse", "efficiency", "irradiation"});
+    result.controllable = parseOptionalBool(json, "controllable");
+    result.symX = parseOptionalBool(json, "symX");
+    result.symY = parseOptionalBool(json, "symY");
+    result.symZ = parseOptionalBool(json, "symZ");
+    if (const Json *replicas = json.find("nReplicas"))
+      result.nReplicas = replicas->asInt();
+    if (const Json *temperature = json.find("minTemperature"))
+      result.minTemperature = temperature->asNumber();
+    if (const Json *temperature = json.find("maxTemperature"))
+      result.maxTemperature = temperature->asNumber();
+    return result;
+  }
+
+  Json settingsToJson(const Fission::Settings &settings) {
+    return Json::object()
+      .set("sizeX", settings.sizeX).set("sizeY", settings.sizeY).set("sizeZ", settings.sizeZ)
+      .set("fuelBasePower", settings.fuelBasePower).set("fuelBaseHeat", settings.fuelBaseHeat)
+      .set("limit", arrayToJson(settings.limit)).set("coolingRates", arrayToJson(settings.coolingRates))
+      .set("ensureActiveCoolerAccessible", settings.ensureActiveCoolerAccessible)
+      .set("ensureHeatNeutral", settings.ensureHeatNeutral).set("goal", settings.goal)
+      .set("symX", settings.symX).set("symY", settings.symY).set("symZ", settings.symZ);
+  }
+
+  Json settingsToJson(const OverhaulFission::Settings &settings) {
+    Json fuels(Json::array());
+    for (auto &fuel : settings.fuels)
+      fuels.push(Json::object().set("efficiency", fuel.efficiency).set("limit", fuel.limit)
+        .set("criticality", fuel.criticality).set("heat", fuel.heat).set("selfPriming", fuel.selfPriming));
+    return Json::object()
+      .set("sizeX", settings.sizeX).set("sizeY", settings.sizeY).set("sizeZ", settings.sizeZ)
+      .set("fuels", std::move(fuels))
+      .set("limits", arrayToJson(settings.limits)).set("sourceLimits", arrayToJson(settings.sourceLimits))
+      .set("goal", settings.goal).set("controllable", settings.controllable)
+      .set("symX", settings.symX).set("symY", settings.symY).set("symZ", settings.symZ)
+      .set("nReplicas", settings.nReplicas).set("minTemperature", settings.minTemperature)
+      .set("maxTemperature", settings.maxTemperature);
+  }
+
+  Config parseConfig(const Json &json) {
+    Config result;
+    const Json *threads(json.find("threads"));
+    result.nThreads = threads ? threads->asInt() : 0;
+    if (result.nThreads <= 0)
+      result.nThreads = std::max(1u, std::thread::hardware_concurrency());
+    const Json *output(json.find("output"));
+    result.output = output ? output->asString() : "results.json";
+    if (const Json *store = json.find("resultStore"))
+      result.resultStore = store->asString();
+    const Json *defaults(json.find("defaults"));
+    for (auto &jobJson : json["jobs"].asArray()) {
+      auto &job(result.jobs.emplace_back());
+      job.name = jobJson["name"].asString();
+      try {
+        auto get([&](const char *key) -> const Json & {
+          const Json *value(lookup(jobJson, defaults, key));
+          if (!value)
+            throw std::runtime_error(std::string("missing \"") + key + "\"");
+          return *value;
+        });
+        const std::string &mode(get("mode").asString());
+        if (mode == "fission") {
+          job.mode = Mode::Fission;
+          job.fissionSettings = parseFissionSettings(get("settings"));
+        } else if (mode == "overhaul") {
+          job.mode = Mode::Overhaul;
+          job.overhaulSettings = parseOverhaulSettings(get("settings"));
+        } else {
+          throw std::runtime_error("unknown mode \"" + mode + "\"");
+        }
+        const Json *value;
+        job.useNet = !(value = lookup(jobJson, defaults, "useNet")) || value->asBool();
+        job.seed = (value = lookup(jobJson, defaults, "seed")) ? static_cast<unsigned>(value->asNumber()) : std::mt19937::default_seed;
+        auto &budget(job.budget);
+        if ((value = lookup(jobJson, defaults, "seconds")))
+          budget.seconds = value->asNumber();
+        if ((value = lookup(jobJson, defaults, "steps")))
+          budget.steps = static_cast<long long>(value->asNumber());
+        if ((value = lookup(jobJson, defaults, "evaluations")))
+          budget.evaluations = static_cast<long long>(value->asNumber());
+        if ((value = lookup(jobJson, defaults, "targetFitness"))) {
+          budget.hasTarget = true;
+          budget.targetFitness = value->asNumber();
+        }
+        if ((value = lookup(jobJson, defaults, "plateauSteps")))
+          budget.plateauSteps = static_cast<long long>(value->asNumber());
+        if ((value = lookup(jobJson, defaults, "plateauEvaluations")))
+          budget.plateauEvaluations = static_cast<long long>(value->asNumber());
+        if ((value = lookup(jobJson, defaults, "plateauSeconds")))
+          budget.plateauSeconds = value->asNumber();
+        job.exact = (value = lookup(jobJson, defaults, "exact")) && value->asBool();
+        if (job.exact && job.mode != Mode::Fission)
+          throw std::runtime_error("\"exact\" is for fission only");
+        if (!job.exact && budget.seconds <= 0.0 && !budget.steps && !budget.evaluations && !budget.plateauSteps
+          && !budget.plateauEvaluations && budget.plateauSeconds <= 0.0)
+          throw std::runtime_error("no budget; set \"seconds\", \"steps\", \"evaluations\" or a plateau limit");
+        if ((value = lookup(jobJson, defaults, "replayFile")))
+          job.replayFile = value->asString();
+        job.profile = (value = lookup(jobJson, defaults, "profile")) && value->asBool();
+        if ((value = lookup(jobJson, defaults, "snapshot")))
+          job.snapshotFile = value->asString();
+        job.nIslands = !job.exact && (value = lookup(jobJson, defaults, "islands")) ? std::max(1, value->asInt()) : 1;
+        job.reuse = (value = lookup(jobJson, defaults, "reuse")) && value->asBool();
+        if ((value = lookup(jobJson, defaults, "initial"))) {
+          Json planner(Json::load(value->asString()));
+          if (job.mode == Mode::Fission)
+            job.initial = Planner::importFission(planner);
+          else
+            job.initial = Planner::importOverhaul(planner, job.overhaulSettings);
+        }
+        job.warmStart = (value = lookup(jobJson, defaults, "warmStart")) && value->asBool();
+        job.polishSweeps = (value = lookup(jobJson, defaults, "polishSweeps")) ? value->asInt() : Fission::defaultPolishSweeps;
+        job.polishSwaps = (value = lookup(jobJson, defaults, "polishSwaps")) && value->asBool();
+      } catch (const std::runtime_error &e) {
+        throw std::runtime_error("job \"" + job.name + "\": " + e.what());
+      }
+    }
+    return result;
+  }
+
+  Json runJobs(const Config &config) {
+    std::vector<std::unique_ptr<JobState>> states;
+    std::vector<std::vector<Common::Task>> islands;
+    std::mutex printMutex;
+    std::unique_ptr<Common::ResultStore> store;
+    if (!config.resultStore.empty())
+      store = std::make_unique<Common::ResultStore>(config.resultStore);
+    int maxIslands{};
+    for (auto &job : config.jobs) {
+      auto &state(*states.emplace_back(std::make_unique<JobState>(job, printMutex, store.get())));
+      auto &jobIslands(islands.emplace_back());
+      if (store && job.reuse) {
+        if (auto stored = store->find(getStoreKey(job), static_cast<int>(job.mode))) {
+          state.result = fromStored(job, *stored);
+          std::cout << job.name << ": found in " << config.resultStore << std::endl;
+          continue;
+        }
+      }
+      if (store && job.warmStart) {
+        if (auto stored = store->find(getStoreKey(job), static_cast<int>(job.mode))) {
+          auto &shape(stored->shape);
+          state.initial = xt::empty<int>({shape[0], shape[1], shape[2]});
+          std::copy(stored->state.begin(), stored->state.end(), state.initial.begin());
+        }
+      }
+      if (job.exact) {
+        jobIslands.emplace_back(makeExact(state));
+        maxIslands = std::max(maxIslands, 1);
+        continue;
+      }
+      for (int i{}; i < job.nIslands; ++i)
+        jobIslands.emplace_back(makeIsland(state, i, state.initial));
+      maxIslands = std::max(maxIslands, job.nIslands);
+    }
+    // Interleaved so that the first pass starts every job before any job's second island.
+    std::vector<Common::Task> tasks;
+    for (int i{}; i < maxIslands; ++i)
+      for (auto &jobIslands : islands)
+        if (i < static_cast<int>(jobIslands.size()))
+          tasks.emplace_back(std::move(jobIslands[i]));
+    // Islands already keep the workers busy; tempering only gets the threads they leave idle.
+    for (auto &state : states)
+      state->nTemperingThreads = std::max(1, config.nThreads / std::max(1, static_cast<int>(tasks.size())));
+    // A worker left without an island to run starts another one for the job that improved most recently, from that job's
+    // best design. Each improvement allows one more, so jobs that have plateaued don't grow.
+    auto spawn([&]() -> Common::Task {
+      JobState *chosen{};
+      Clock::time_point latest;
+      for (auto &state : states) {
+        std::lock_guard lock(state->mutex);
+        if (!state->job.exact && state->nRunning && !state->isFailed && state->canSpawn && (!chosen || state->improvedAt > latest)) {
+          chosen = state.get();
+          latest = state->improvedAt;
+        }
+      }
+      if (!chosen)
+        return {};
+      std::lock_guard lock(chosen->mutex);
+      if (!chosen->nRunning || chosen->isFailed || !chosen->canSpawn)
+        return {};
+      chosen->canSpawn = false;
+      ++chosen->nRunning;
+      chosen->islands.emplace_back();
+      return makeIsland(*chosen, static_cast<int>(chosen->islands.size()) - 1, chosen->bestState);
+    });
+    Common::runWorkStealing(config.nThreads, std::move(tasks), spawn);
+    Json jobs(Json::array());
+    for (auto &state : states)
+      jobs.push(std::move(state->result));
+    return Json::object().set("jobs", std::move(jobs));
+  }
+}
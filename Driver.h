@@ -0,0 +1,67 @@
+#ifndef _DRIVER_H_
+#define _DRIVER_H_
+#include "Budget.h"
+#include "Json.h"
+#include "Fission.h"
+#include "OverhaulFission.h"
+
+namespace Driver {
+  enum class Mode { Fission, Overhaul };
+
+  struct Job {
+    std::string name;
+    Mode mode;
+    Fission::Settings fissionSettings;
+    OverhaulFission::Settings overhaulSettings;
+    bool useNet;
+    unsigned seed;
+    Common::Budget budget;
+    std::string replayFile;
+    // Adds stage and evaluation phase timings to the counters in the result.
+    bool profile;
+    // Kept up to date with the best design while the job runs, for watching long jobs.
+    std::string snapshotFile;
+    // Independent runs with consecutive seeds; the job reports the best of them. More may be started while it runs, see runJobs.
+    int nIslands;
+    // Answers from the result store when it has a design for these settings, without running.
+    bool reuse;
+    // Design the islands start from, imported from a planner file; empty for random ones.
+    xt::xtensor<int, 3> initial;
+    // Starts from the result store's design for these settings instead, when it has one.
+    bool warmStart;
+    // Fission only: searches exhaustively for a proven optimum instead, as one island. The budget may be empty.
+    bool exact;
+    // Fission only: see Fission::Opt::setPolish.
+    int polishSweeps;
+    bool polishSwaps;
+  };
+
+  struct Config {
+    int nThreads;
+    std::string output;
+    // Finished jobs offer their best design to this store, keyed by Settings::hash(); empty for none.
+    std::string resultStore;
+    std::vector<Job> jobs;
+  };
+
+  Fission::Settings parseFissionSettings(const Common::Json &json);
+  OverhaulFission::Settings parseOverhaulSettings(const Common::Json &json);
+  // Inverses of the parsers, for writing reproducible cases.
+  Common::Json settingsToJson(const Fission::Settings &settings);
+  Common::Json settingsToJson(const OverhaulFission::Settings &settings);
+  // {"threads": 4, "output": "results.json", "resultStore": "results.db", "defaults": {...}, "jobs": [{...}, ...]}
+  // A job has "name", "mode" ("fission" or "overhaul"), "settings", a budget made of any of "seconds", "steps",
+  //   "evaluations", "targetFitness", "plateauSteps", "plateauEvaluations" and "plateauSeconds" (see Common::Budget),
+  //   and optionally "seed", "islands", "useNet" (fission only), "replayFile", "profile", "snapshot", "reuse",
+  //   "initial" (a file saved for Hellrage's reactor planner), "warmStart", "exact", "polishSweeps" and "polishSwaps"
+  //   (the last three fission only); any of them but "name" may come from "defaults" instead.
+  // Settings use the member names of the Settings structs, with tile limits as arrays in enum order.
+  Config parseConfig(const Common::Json &json);
+  // Runs the islands of all jobs in time slices on nThreads work-stealing workers and returns the results in job order.
+  // Islands that stop improving queue behind the ones still improving, and finish on their plateau limits. That only moves
+  // threads between islands while they outnumber the threads, so a worker with no island left to run starts another one
+  // for the job that improved last, from that job's best design, once per improvement.
+  Common::Json runJobs(const Config &config);
+}
+
+#endif
@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include "ExactFission.h"
+
+namespace Fission {
+  namespace {
+    constexpr int unassigned(Air + 1);
+    // Nodes between budget checks.
+    constexpr long long checkPeriod(256);
+  }
+
+  ExactSolver::ExactSolver(const Settings &settings)
+    :settings(settings), evaluator(settings), tracker(), lastImprovement(), isStopped() {
+    for (int x(settings.symX ? settings.sizeX / 2 : 0); x < settings.sizeX; ++x) {
+      for (int y(settings.symY ? settings.sizeY / 2 : 0); y < settings.sizeY; ++y) {
+        for (int z(settings.symZ ? settings.sizeZ / 2 : 0); z < settings.sizeZ; ++z) {
+          coords.emplace_back(x, y, z);
+          int nSym(1);
+          if (settings.symX && x != settings.sizeX - x - 1)
+            nSym *= 2;
+          if (settings.symY && y != settings.sizeY - y - 1)
+            nSym *= 2;
+          if (settings.symZ && z != settings.sizeZ - z - 1)
+            nSym *= 2;
+          nSyms.emplace_back(nSym);
+        }
+      }
+    }
+    for (int tile{}; tile < Cell; ++tile)
+      order.emplace_back(tile);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+      return settings.coolingRates[a] > settings.coolingRates[b];
+    });
+    order.insert(order.begin(), {Cell, Moderator});
+    order.emplace_back(Air);
+  }
+
+  // Same as Opt's, so that results compare.
+  bool ExactSolver::feasible(const Evaluation &x) const {
+    return !settings.ensureHeatNeutral || x.netHeat <= 0.0;
+  }
+
+  double ExactSolver::rawFitness(const Evaluation &x) const {
+    switch (settings.goal) {
+      default: // GoalPower
+        return x.avgMult;
+      case GoalBreeder:
+        return x.avgBreed;
+      case GoalEfficiency:
+        return settings.ensureHeatNeutral ? (x.efficiency - 1) * x.dutyCycle : x.efficiency - 1;
+    }
+  }
+
+  void ExactSolver::setTileWithSym(int x, int y, int z, int tile) {
+    for (int mx : {x, settings.symX ? settings.sizeX - x - 1 : x})
+      for (int my : {y, settings.symY ? settings.sizeY - y - 1 : y})
+        for (int mz : {z, settings.symZ ? settings.sizeZ - z - 1 : z})
+          state(mx, my, mz) = tile;
+  }
+
+  // Whether the position holds the tile or is unassigned with some of the tile left.
+  bool ExactSolver::canBe(int tile, int x, int y, int z) const {
+    if (!state.in_bounds(x, y, z))
+      return false;
+    int current(state(x, y, z));
+    return current == tile || (current == unassigned && limit[tile]);
+  }
+
+  int ExactSolver::countCanBe(int tile, int x, int y, int z) const {
+    return
+      + canBe(tile, x - 1, y, z)
+      + canBe(tile, x + 1, y, z)
+      + canBe(tile, x, y - 1, z)
+      + canBe(tile, x, y + 1, z)
+      + canBe(tile, x, y, z - 1)
+      + canBe(tile, x, y, z + 1);
+  }
+
+  // The placement rules of Evaluator::run, with every neighbor that could still be a tile taken as an active one.
+  bool ExactSolver::canBeActive(int tile, int x, int y, int z) const {
+    int nCasing(
+      + !x + (x == settings.sizeX - 1)
+      + !y + (y == settings.sizeY - 1)
+      + !z + (z == settings.sizeZ - 1));
+    switch (tile < Active ? tile : tile - Active) {
+      case Water:
+        return countCanBe(Cell, x, y, z) || countCanBe(Moderator, x, y, z);
+      case Redstone:
+        return countCanBe(Cell, x, y, z);
+      case Quartz:
+        return countCanBe(Moderator, x, y, z);
+      case Gold:
+        return countCanBe(Water, x, y, z) && countCanBe(Redstone, x, y, z);
+      case Glowstone:
+        return countCanBe(Moderator, x, y, z) >= 2;
+      case Lapis:
+        return countCanBe(Cell, x, y, z) && nCasing;
+      case Diamond:
+        return countCanBe(Water, x, y, z) && countCanBe(Quartz, x, y, z);
+      case Helium:
+        return countCanBe(Redstone, x, y, z) && nCasing;
+      case Enderium:
+        return nCasing == 3
+          && (!x || x == settings.sizeX - 1)
+          && (!y || y == settings.sizeY - 1)
+          && (!z || z == settings.sizeZ - 1);
+      case Cryotheum:
+        return countCanBe(Cell, x, y, z) >= 2;
+      case Iron:
+        return countCanBe(Gold, x, y, z);
+      case Emerald:
+        return countCanBe(Moderator, x, y, z) && countCanBe(Cell, x, y, z);
+      case Copper:
+        return countCanBe(Glowstone, x, y, z);
+      case Tin:
+        return (canBe(Lapis, x - 1, y, z) && canBe(Lapis, x + 1, y, z))
+          || (canBe(Lapis, x, y - 1, z) && canBe(Lapis, x, y + 1, z))
+          || (canBe(Lapis, x, y, z - 1) && canBe(Lapis, x, y, z + 1));
+      default: // Magnesium
+        return countCanBe(Moderator, x, y, z) && nCasing;
+    }
+  }
+
+  // Bounds mult * (1 + adjacent moderators / 6) for a cell here. Each direction adds to mult if a cell is adjacent or
+  //   a line of moderators reaches one, as in Evaluator::countMult, and to the moderators if one is adjacent.
+  double ExactSolver::getCellBound(int x, int y, int z) const {
+    static constexpr int directions[6][3] { {-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1} };
+    // Directions where the adjacent position could only be one of a cell or a moderator are decided below.
+    int mult(1), nModerators{}, nEither{};
+    for (auto &[dx, dy, dz] : directions) {
+      bool isCell(canBe(Cell, x + dx, y + dy, z + dz)), isModerator(canBe(Moderator, x + dx, y + dy, z + dz));
+      bool isReached{};
+      for (int n(2); isModerator && n <= neutronReach + 1; ++n) {
+        int nx(x + dx * n), ny(y + dy * n), nz(z + dz * n);
+        if (canBe(Cell, nx, ny, nz)) {
+          isReached = true;
+          break;
+        }
+        if (!canBe(Moderator, nx, ny, nz))
+          break;
+      }
+      if (isReached) {
+        ++mult;
+        ++nModerators;
+      } else if (isCell && isModerator) {
+        ++nEither;
+      } else {
+        mult += isCell;
+        nModerators += isModerator;
+      }
+    }
+    double result{};
+    for (int i{}; i <= nEither; ++i)
+      result = std::max(result, (mult + i) * (1.0 + (nModerators + nEither - i) / 6.0));
+    return result;
+  }
+
+  // Bounds the raw fitness of every completion of the assigned positions.
+  // Power is summed per cell as mult * (1 + adjacent moderators / 6), which is how the moderators' share adds up.
+  // Since heatMult >= powerMult >= breed, fitness is also at most cooling / fuelBaseHeat for power and breeding.
+  double ExactSolver::getBound() {
+    double power{}, cooling{};
+    int nCells{};
+    candidates.clear();
+    for (int x{}; x < settings.sizeX; ++x) {
+      for (int y{}; y < settings.sizeY; ++y) {
+        for (int z{}; z < settings.sizeZ; ++z) {
+          int tile(state(x, y, z));
+          double cellBound{};
+          if (tile == Cell || (tile == unassigned && limit[Cell]))
+            cellBound = getCellBound(x, y, z);
+          if (tile == Cell) {
+            power += cellBound;
+            ++nCells;
+          } else if (tile < Cell) {
+            if (canBeActive(tile, x, y, z))
+              cooling += settings.coolingRates[tile];
+          } else if (tile == unassigned) {
+            double best{};
+            for (int cooler : order) {
+              if (cooler < Cell && limit[cooler] && canBeActive(cooler, x, y, z)) {
+                best = settings.coolingRates[cooler];
+                break;
+              }
+            }
+            cooling += best;
+            if (cellBound)
+              candidates.emplace_back(settings.goal == GoalBreeder ? 1.0 : cellBound, best);
+          }
+        }
+      }
+    }
+    if (settings.ensureHeatNeutral && cooling < settings.fuelBaseHeat * nCells)
+      return -std::numeric_limits<double>::infinity();
+    double base(settings.goal == GoalBreeder ? nCells : power);
+
+    // With no more cells than the limit allows.
+    int nMore(static_cast<int>(candidates.size()));
+    if (limit[Cell] >= 0)
+      nMore = std::min(nMore, limit[Cell]);
+    cellBounds.clear();
+    for (auto &candidate : candidates)
+      cellBounds.emplace_back(candidate.first);
+    std::partial_sort(cellBounds.begin(), cellBounds.begin() + nMore, cellBounds.end(), std::greater<double>());
+    if (settings.goal == GoalEfficiency) {
+      // The best power per cell, adding the strongest cells first; no cells at all is an efficiency of 1.
+      double best(nCells ? power / nCells : 1.0);
+      for (int i{}; i < nMore; ++i) {
+        power += cellBounds[i];
+        best = std::max(best, power / (nCells + i + 1));
+      }
+      return best - 1;
+    }
+    double byCount(base);
+    for (int i{}; i < nMore; ++i)
+      byCount += cellBounds[i];
+
+    // A position is either a cell or a cooler: turn the ones giving the most power per cooling into cells, fractionally,
+    //   until power meets cooling / fuelBaseHeat.
+    std::sort(candidates.begin(), candidates.end(), [](auto &a, auto &b) {
+      return a.first * b.second > b.first * a.second;
+    });
+    double a(base), b(cooling / settings.fuelBaseHeat);
+    for (auto &[cellPower, coolerCooling] : candidates) {
+      if (a >= b)
+        break;
+      double loss(coolerCooling / settings.fuelBaseHeat);
+      if (a + cellPower >= b - loss) {
+        a += cellPower * (b - a) / (cellPower + loss);
+        b = a;
+        break;
+      }
+      a += cellPower;
+      b -= loss;
+    }
+    return std::min({a, b, byCount});
+  }
+
+  void ExactSolver::evaluate() {
+    evaluator.run(state, value);
+    ++result.nEvaluations;
+    if (!feasible(value))
+      return;
+    double fitness(rawFitness(value));
+    if (fitness <= result.fitness)
+      return;
+    result.fitness = fitness;
+    lastImprovement = result.nNodes;
+    auto &best(result.best);
+    best.state = state;
+    best.value = value;
+    std::copy(limit, limit + Air, best.limit);
+    std::fill(best.tileCounts, best.tileCounts + Air + 1, 0);
+    for (int tile : state)
+      ++best.tileCounts[tile];
+  }
+
+  void ExactSolver::search(int depth) {
+    ++result.nNodes;
+    if (!(result.nNodes % checkPeriod)
+      && tracker->check(result.nNodes, result.nEvaluations, lastImprovement, result.fitness, result.stopReason))
+      isStopped = true;
+    if (isStopped)
+      return;
+    if (depth == static_cast<int>(coords.size())) {
+      evaluate();
+      return;
+    }
+    if (getBound() <= result.fitness)
+      return;
+    auto &[x, y, z](coords[depth]);
+    int nSym(nSyms[depth]);
+    for (int tile : order) {
+      if (tile != Air) {
+        if (limit[tile] >= 0 && limit[tile] < nSym)
+          continue;
+        // A cooler that can't become active is no better than air, which takes nothing from the limits.
+        if (tile < Cell && !canBeActive(tile, x, y, z))
+          continue;
+        limit[tile] -= nSym;
+      }
+      setTileWithSym(x, y, z, tile);
+      search(depth + 1);
+      if (tile != Air)
+        limit[tile] += nSym;
+      if (isStopped)
+        break;
+    }
+    setTileWithSym(x, y, z, unassigned);
+  }
+
+  ExactResult ExactSolver::solve(const Common::Budget &budget) {
+    result = ExactResult();
+    // The empty design is the baseline, as it is for Opt's best.
+    auto &best(result.best);
+    best.state = xt::empty<int>({settings.sizeX, settings.sizeY, settings.sizeZ});
+    best.state.fill(Air);
+    evaluator.run(best.state, best.value);
+    ++result.nEvaluations;
+    result.fitness = rawFitness(best.value);
+    std::copy(settings.limit, settings.limit + Air, best.limit);
+    std::fill(best.tileCounts, best.tileCounts + Air + 1, 0);
+    best.tileCounts[Air] = settings.sizeX * settings.sizeY * settings.sizeZ;
+
+    state = xt::empty<int>({settings.sizeX, settings.sizeY, settings.sizeZ});
+    state.fill(unassigned);
+    std::copy(settings.limit, settings.limit + Air, limit);
+    Common::BudgetTracker budgetTracker(budget, 0, 0, 0);
+    tracker = &budgetTracker;
+    lastImprovement = 0;
+    isStopped = false;
+    search(0);
+    tracker = nullptr;
+    result.isOptimal = !isStopped;
+    return result;
+  }
+}
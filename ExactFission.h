@@ -0,0 +1,56 @@
+#ifndef _EXACT_FISSION_H_
+#define _EXACT_FISSION_H_
+#include "Budget.h"
+#include "OptFission.h"
+
+namespace Fission {
+  struct ExactResult {
+    // Whether the search ran to the end, which proves best optimal; otherwise stopReason says what cut it short.
+    bool isOptimal;
+    Common::StopReason stopReason;
+    long long nNodes, nEvaluations;
+    // Raw fitness of best, as Opt::getBestFitness.
+    double fitness;
+    Sample best;
+  };
+
+  // Branch and bound over the tiles of the symmetric fundamental domain, for reactors small enough to enumerate.
+  // Positions are assigned in turn within the limits, and a branch is cut when an optimistic bound on the fitness of
+  //   all its completions can't beat the best design so far. Fitness and feasibility are the same as Opt's.
+  class ExactSolver {
+    const Settings &settings;
+    Evaluator evaluator;
+    Coords coords;
+    std::vector<int> nSyms;
+    // Cells and moderators first, then coolers by cooling rate and air last, to find good designs early.
+    std::vector<int> order;
+    // Unassigned positions hold Air + 1.
+    xt::xtensor<int, 3> state;
+    // Remaining counts, negative for unlimited.
+    int limit[Air];
+    Evaluation value;
+    // Unassigned positions that could be cells: the power they would add as a cell and the cooling as a cooler.
+    std::vector<std::pair<double, double>> candidates;
+    std::vector<double> cellBounds;
+    Common::BudgetTracker *tracker;
+    ExactResult result;
+    long long lastImprovement;
+    bool isStopped;
+    bool feasible(const Evaluation &x) const;
+    double rawFitness(const Evaluation &x) const;
+    void setTileWithSym(int x, int y, int z, int tile);
+    bool canBe(int tile, int x, int y, int z) const;
+    int countCanBe(int tile, int x, int y, int z) const;
+    bool canBeActive(int tile, int x, int y, int z) const;
+    double getCellBound(int x, int y, int z) const;
+    double getBound();
+    void evaluate();
+    void search(int depth);
+  public:
+    explicit ExactSolver(const Settings &settings);
+    // An empty budget searches to the end, which takes time exponential in the size of the fundamental domain.
+    ExactResult solve(const Common::Budget &budget = {});
+  };
+}
+
+#endif
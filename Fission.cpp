@@ -1,7 +1,26 @@
 #include <xtensor/xview.hpp>
+#include "Hash.h"
 #include "Fission.h"
 
 namespace Fission {
+  std::uint64_t Settings::hash() const {
+    Common::Hasher hasher;
+    hasher.add(sizeX);
+    hasher.add(sizeY);
+    hasher.add(sizeZ);
+    hasher.add(fuelBasePower);
+    hasher.add(fuelBaseHeat);
+    hasher.add(limit);
+    hasher.add(coolingRates);
+    hasher.add(ensureActiveCoolerAccessible);
+    hasher.add(ensureHeatNeutral);
+    hasher.add(goal);
+    hasher.add(symX);
+    hasher.add(symY);
+    hasher.add(symZ);
+    return hasher.get();
+  }
+
   void Evaluation::compute(const Settings &settings) {
     heat = settings.fuelBaseHeat * heatMult;
     netHeat = heat - cooling;
@@ -19,7 +38,7 @@ namespace Fission {
     rules(xt::empty<int>({settings.sizeX, settings.sizeY, settings.sizeZ})),
     isActive(xt::empty<bool>({settings.sizeX, settings.sizeY, settings.sizeZ})),
     isModeratorInLine(xt::empty<bool>({settings.sizeX, settings.sizeY, settings.sizeZ})),
-    visited(xt::empty<bool>({settings.sizeX, settings.sizeY, settings.sizeZ})) {}
+    visited(xt::empty<bool>({settings.sizeX, settings.sizeY, settings.sizeZ})), profile() {}
 
   int Evaluator::getTileSafe(int x, int y, int z) const {
     if (!state->in_bounds(x, y, z))
@@ -127,6 +146,8 @@ namespace Fission {
   }
 
   void Evaluator::run(const xt::xtensor<int, 3> &state, Evaluation &result) {
+    Common::TraceScope trace("evaluate");
+    Common::PhaseTimer timer(profile);
     result.invalidTiles.clear();
     result.powerMult = 0.0;
     result.heatMult = 0.0;
@@ -203,6 +224,7 @@ namespace Fission {
       }
     }
     
+    timer.next(Common::PhaseHeatSinks);
     for (int x{}; x < settings.sizeX; ++x) {
       for (int y{}; y < settings.sizeY; ++y) {
         for (int z{}; z < settings.sizeZ; ++z) {
@@ -277,6 +299,7 @@ namespace Fission {
       }
     }
 
+    timer.next(Common::PhaseStats);
     result.compute(settings);
   }
 }
@@ -1,7 +1,9 @@
 #ifndef _FISSION_H_
 #define _FISSION_H_
 #include <xtensor/xtensor.hpp>
+#include <cstdint>
 #include <string>
+#include "Counters.h"
 
 namespace Fission {
   using Coords = std::vector<std::tuple<int, int, int>>;
@@ -33,6 +35,9 @@ namespace Fission {
     bool ensureHeatNeutral;
     int goal;
     bool symX, symY, symZ;
+
+    // Stable across runs, for matching results and replay files to the settings that produced them.
+    std::uint64_t hash() const;
   };
 
   struct Evaluation {
@@ -52,6 +57,7 @@ namespace Fission {
     xt::xtensor<bool, 3> isActive, isModeratorInLine, visited;
     const xt::xtensor<int, 3> *state;
     int compatibleTile;
+    Common::PhaseProfile *profile;
 
     int getTileSafe(int x, int y, int z) const;
     int getMultSafe(int x, int y, int z) const;
@@ -66,6 +72,8 @@ namespace Fission {
     bool checkAccessibility(int x, int y, int z);
   public:
     Evaluator(const Settings &settings);
+    // Null turns profiling off.
+    void setProfile(Common::PhaseProfile *profile) { this->profile = profile; }
     void run(const xt::xtensor<int, 3> &state, Evaluation &result);
   };
 }
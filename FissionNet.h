@@ -1,23 +1,32 @@
 #ifndef _FISSION_NET_H_
 #define _FISSION_NET_H_
-#include <unordered_map>
+#include "QuantizedNet.h"
+#include "Gemm.h"
+#include "ReplayPool.h"
 #include "OptFission.h"
 
 namespace Fission {
-  constexpr int nStatisticalFeatures(5), nLayer1(128), nLayer2(64), nMiniBatch(64), nEpoch(2), nPool(1'000'000);
-  constexpr double lRate(0.01), mRate(0.9), rRate(0.999), leak(0.1);
+  constexpr int nStatisticalFeatures(5), nLayer1(128), nLayer2(64), nMiniBatch(64), nEpoch(2), nPool(1'000'000), nQuantizationCheck(256);
+  constexpr double lRate(0.01), mRate(0.9), rRate(0.999), leak(0.1), quantizationTolerance(0.01);
+  // Replay options: prioritized sampling corrects its bias with importance weights annealed by replayBeta.
+  constexpr bool prioritizedReplay(false), deduplicatedReplay(false);
+  constexpr double replayAlpha(0.6), replayBeta(0.4);
 
   class Net {
     Opt &opt;
+    // Separate from opt.rng because training may run on a background thread.
+    std::mt19937 rng;
     double mCorrector, rCorrector;
-    std::unordered_map<int, int> tileMap;
-    int nFeatures;
+    // Feature index of each tile type, or -1 for types that can't appear.
+    std::vector<int> tileMap;
+    int nTileTypes, nFeatures;
 
     // Data Pool
     xt::xtensor<double, 2> batchInput;
-    xt::xtensor<double, 1> batchTarget;
-    std::vector<std::pair<xt::xtensor<double, 1>, double>> pool;
-    int trajectoryLength, writePos;
+    xt::xtensor<double, 1> batchTarget, batchWeight;
+    std::vector<int> batchRows;
+    xt::xtensor<double, 1> vInput;
+    Common::ReplayPool pool;
 
     xt::xtensor<double, 2> wLayer1, mwLayer1, rwLayer1;
     xt::xtensor<double, 1> bLayer1, mbLayer1, rbLayer1;
@@ -26,15 +35,33 @@ namespace Fission {
     xt::xtensor<double, 1> wOutput, mwOutput, rwOutput;
     double bOutput, mbOutput, rbOutput;
 
-    xt::xtensor<double, 1> extractFeatures(const Sample &sample);
+    // Inference copies of the weights, rebuilt lazily after training.
+    // Layer 1 is stored transposed so that inference only reads the columns of non-zero features.
+    xt::xtensor<double, 2> wLayer1T;
+    Common::QuantizedNet quantized;
+    bool isPrepared, useQuantized;
+    double quantizationError;
+    Common::SparseRows sparseInput;
+
+    void appendSparse(const Sample &sample);
+    xt::xtensor<double, 1> forward(const Common::SparseRows &input);
+    void prepareInference();
+
+    const xt::xtensor<double, 1> &extractFeatures(const Sample &sample);
   public:
     Net(Opt &opt);
     double infer(const Sample &sample);
-    void newTrajectory() { trajectoryLength = 0; }
+    xt::xtensor<double, 1> inferBatch(const Sample *samples, int n);
+    // Keeps the replay pool in a memory-mapped file, reusing one left by a run with the same settings.
+    bool openReplayFile(const std::string &path) { return pool.openFile(path, opt.settings.hash()); }
+    void newTrajectory() { pool.newTrajectory(); }
     void appendTrajectory(const Sample &sample);
     void finishTrajectory(double target);
-    int getTrajectoryLength() const { return trajectoryLength; }
+    int getTrajectoryLength() const { return pool.getTrajectoryLength(); }
+    const Common::ReplayPool &getPool() const { return pool; }
     double train();
+    // Max deviation of the quantized path from the float path, relative to the output magnitude.
+    double getQuantizationError() const { return quantizationError; }
   };
 }
 
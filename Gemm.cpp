@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <vector>
+#include "Gemm.h"
+
+namespace Common {
+  namespace {
+    constexpr int blockRows(4), blockK(128), blockN(512), nLanes(8);
+
+    // Updates rows [i, i + blockRows) of C with A(r, p) read through the strides (ai, ap),
+    //   so the same kernel serves both A and A^T.
+    void kernel4(int n, int k0, int k1, const double *a, int ai, int ap,
+      const double *b, int ldb, double *c, int ldc) {
+      double *__restrict c0(c);
+      double *__restrict c1(c + ldc);
+      double *__restrict c2(c + 2 * ldc);
+      double *__restrict c3(c + 3 * ldc);
+      for (int p(k0); p < k1; ++p) {
+        double a0(a[p * ap]), a1(a[ai + p * ap]), a2(a[2 * ai + p * ap]), a3(a[3 * ai + p * ap]);
+        const double *__restrict bp(b + p * ldb);
+        for (int j{}; j < n; ++j) {
+          double bj(bp[j]);
+          c0[j] += a0 * bj;
+          c1[j] += a1 * bj;
+          c2[j] += a2 * bj;
+          c3[j] += a3 * bj;
+        }
+      }
+    }
+
+    void kernel1(int n, int k0, int k1, const double *a, int ap,
+      const double *b, int ldb, double *c) {
+      double *__restrict c0(c);
+      for (int p(k0); p < k1; ++p) {
+        double a0(a[p * ap]);
+        const double *__restrict bp(b + p * ldb);
+        for (int j{}; j < n; ++j)
+          c0[j] += a0 * bp[j];
+      }
+    }
+
+    void blocked(int m, int n, int k, const double *a, int ai, int ap, const double *b, double *c) {
+      for (int j0{}; j0 < n; j0 += blockN) {
+        int nj(std::min(blockN, n - j0));
+        for (int k0{}; k0 < k; k0 += blockK) {
+          int k1(std::min(k, k0 + blockK));
+          int i{};
+          for (; i + blockRows <= m; i += blockRows)
+            kernel4(nj, k0, k1, a + i * ai, ai, ap, b + j0, n, c + i * n + j0, n);
+          for (; i < m; ++i)
+            kernel1(nj, k0, k1, a + i * ai, ap, b + j0, n, c + i * n + j0);
+        }
+      }
+    }
+  }
+
+  void gemmNN(int m, int n, int k, const double *a, const double *b, double *c) {
+    if (n == 1)
+      gemv(m, k, a, b, c);
+    else
+      blocked(m, n, k, a, k, 1, b, c);
+  }
+
+  void gemmNT(int m, int n, int k, const double *a, const double *b, double *c) {
+    // Packing B^T once costs O(nk) and turns every update into the contiguous axpy form.
+    thread_local std::vector<double> packed;
+    packed.resize(static_cast<std::size_t>(n) * k);
+    for (int j{}; j < n; ++j)
+      for (int p{}; p < k; ++p)
+        packed[p * n + j] = b[j * k + p];
+    blocked(m, n, k, a, k, 1, packed.data(), c);
+  }
+
+  void gemmTN(int m, int n, int k, const double *a, const double *b, double *c) {
+    blocked(m, n, k, a, 1, m, b, c);
+  }
+
+  double dot(int n, const double *a, const double *b) {
+    double acc[nLanes]{};
+    int i{};
+    for (; i + nLanes <= n; i += nLanes)
+      for (int j{}; j < nLanes; ++j)
+        acc[j] += a[i + j] * b[i + j];
+    double result{};
+    for (; i < n; ++i)
+      result += a[i] * b[i];
+    for (int j{}; j < nLanes; ++j)
+      result += acc[j];
+    return result;
+  }
+
+  void gemv(int m, int n, const double *a, const double *x, double *y) {
+    for (int i{}; i < m; ++i)
+      y[i] += dot(n, a + i * n, x);
+  }
+
+  void spmm(int m, const double *aT, const SparseRows &x, double *c) {
+    int n(x.getNRows());
+    if (n == 1) {
+      double *__restrict c0(c);
+      for (int p(x.offsets[0]); p < x.offsets[1]; ++p) {
+        const double *__restrict column(aT + static_cast<std::size_t>(x.indices[p]) * m);
+        double value(x.values[p]);
+        for (int i{}; i < m; ++i)
+          c0[i] += value * column[i];
+      }
+      return;
+    }
+    for (int s{}; s < n; ++s)
+      for (int p(x.offsets[s]); p < x.offsets[s + 1]; ++p) {
+        const double *column(aT + static_cast<std::size_t>(x.indices[p]) * m);
+        double value(x.values[p]);
+        for (int i{}; i < m; ++i)
+          c[i * n + s] += value * column[i];
+      }
+  }
+}
@@ -0,0 +1,35 @@
+#ifndef _GEMM_H_
+#define _GEMM_H_
+#include <vector>
+
+namespace Common {
+  // Dense row-major kernels for the surrogate networks. All of them accumulate into the output (C += A * B),
+  //   so callers initialize C with zeros or with the broadcast bias.
+  // The inner loops are written as contiguous axpy updates over restrict pointers so that they auto-vectorize.
+
+  // C[m, n] += A[m, k] * B[k, n]
+  void gemmNN(int m, int n, int k, const double *a, const double *b, double *c);
+  // C[m, n] += A[m, k] * B[n, k]^T
+  void gemmNT(int m, int n, int k, const double *a, const double *b, double *c);
+  // C[m, n] += A[k, m]^T * B[k, n]
+  void gemmTN(int m, int n, int k, const double *a, const double *b, double *c);
+  // y[m] += A[m, n] * x[n]
+  void gemv(int m, int n, const double *a, const double *x, double *y);
+  double dot(int n, const double *a, const double *b);
+
+  // Non-zero entries of a batch of input vectors in CSR form, one row per sample.
+  struct SparseRows {
+    std::vector<int> offsets{0}, indices;
+    std::vector<double> values;
+    void clear() { offsets.assign(1, 0); indices.clear(); values.clear(); }
+    void push(int index, double value) { indices.push_back(index); values.push_back(value); }
+    void finishRow() { offsets.push_back(static_cast<int>(indices.size())); }
+    int getNRows() const { return static_cast<int>(offsets.size()) - 1; }
+  };
+
+  // C[m, n] += AT[k, m]^T * X^T where row s of the sparse X is column s of the product and n = X.getNRows().
+  // Only the columns of A selected by non-zeros are touched, so A is passed transposed to keep them contiguous.
+  void spmm(int m, const double *aT, const SparseRows &x, double *c);
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace Common {
+  // FNV-1a, for content hashes that have to stay stable across runs.
+  class Hasher {
+    std::uint64_t value{14695981039346656037ull};
+  public:
+    void addBytes(const void *data, std::size_t n) {
+      auto bytes(static_cast<const unsigned char *>(data));
+      for (std::size_t i{}; i < n; ++i) {
+        value ^= bytes[i];
+        value *= 1099511628211ull;
+      }
+    }
+    template<class T> void add(const T &x) {
+      static_assert(std::is_arithmetic_v<T>, "hash fields one at a time so that padding doesn't leak in");
+      addBytes(&x, sizeof(x));
+    }
+    template<class T, std::size_t N> void add(const T (&x)[N]) {
+      for (auto &i : x)
+        add(i);
+    }
+    std::uint64_t get() const { return value; }
+  };
+}
+
+#endif
@@ -0,0 +1,375 @@
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "Json.h"
+
+namespace Common {
+  namespace {
+    const char *typeNames[] { "null", "bool", "number", "string", "array", "object" };
+
+    class Parser {
+      const std::string &text;
+      std::size_t pos;
+
+      [[noreturn]] void fail(const std::string &what) const {
+        int line(1), column(1);
+        for (std::size_t i{}; i < pos && i < text.size(); ++i) {
+          if (text[i] == '\n') {
+            ++line;
+            column = 1;
+          } else {
+            ++column;
+          }
+        }
+        throw std::runtime_error("JSON: " + what + " at line " + std::to_string(line) + ", column " + std::to_string(column));
+      }
+
+      void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r'))
+          ++pos;
+      }
+
+      bool consume(char c) {
+        skipSpace();
+        if (pos < text.size() && text[pos] == c) {
+          ++pos;
+          return true;
+        }
+        return false;
+      }
+
+      void require(char c) {
+        if (!consume(c))
+          fail(std::string("expected '") + c + "'");
+      }
+
+      bool consumeWord(const char *word) {
+        std::size_t n(std::char_traits<char>::length(word));
+        if (text.compare(pos, n, word))
+          return false;
+        pos += n;
+        return true;
+      }
+
+      void appendUtf8(std::string &out, unsigned code) {
+        if (code < 0x80) {
+          out += static_cast<char>(code);
+        } else if (code < 0x800) {
+          out += static_cast<char>(0xC0 | code >> 6);
+          out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+          out += static_cast<char>(0xE0 | code >> 12);
+          out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+          out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+          out += static_cast<char>(0xF0 | code >> 18);
+          out += static_cast<char>(0x80 | (code >> 12 & 0x3F));
+          out += static_cast<char>(0x80 | (code >> 6 & 0x3F));
+          out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+      }
+
+      unsigned parseHex4() {
+        if (pos + 4 > text.size())
+          fail("truncated escape");
+        unsigned code{};
+        for (int i{}; i < 4; ++i) {
+          char c(text[pos++]);
+          code <<= 4;
+          if (c >= '0' && c <= '9')
+            code |= c - '0';
+          else if (c >= 'a' && c <= 'f')
+            code |= c - 'a' + 10;
+          else if (c >= 'A' && c <= 'F')
+            code |= c - 'A' + 10;
+          else
+            fail("bad escape");
+        }
+        return code;
+      }
+
+      std::string parseString() {
+        require('"');
+        std::string result;
+        while (true) {
+          if (pos >= text.size())
+            fail("unterminated string");
+          char c(text[pos++]);
+          if (c == '"')
+            return result;
+          if (c != '\\') {
+            result += c;
+            continue;
+          }
+          if (pos >= text.size())
+            fail("unterminated string");
+          switch (text[pos++]) {
+            case '"': result += '"'; break;
+            case '\\': result += '\\'; break;
+            case '/': result += '/'; break;
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'n': result += '\n'; break;
+            case 'r': result += '\r'; break;
+            case 't': result += '\t'; break;
+            case 'u': {
+              unsigned code(parseHex4());
+              if (code >= 0xD800 && code < 0xDC00 && consumeWord("\\u")) {
+                unsigned low(parseHex4());
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+              }
+              appendUtf8(result, code);
+              break;
+            }
+            default:
+              fail("bad escape");
+          }
+        }
+      }
+
+      Json parseNumber() {
+        const char *begin(text.c_str() + pos);
+        char *end;
+        double value(std::strtod(begin, &end));
+        if (end == begin)
+          fail("unexpected character");
+        pos += end - begin;
+        return value;
+      }
+
+    public:
+      Parser(const std::string &text) :text(text), pos() {}
+
+      Json parseValue() {
+        skipSpace();
+        if (pos >= text.size())
+          fail("unexpected end");
+        char c(text[pos]);
+        if (c == '{') {
+          ++pos;
+          Json result(Json::object());
+          if (consume('}'))
+            return result;
+          do {
+            skipSpace();
+            std::string key(parseString());
+            require(':');
+            result.set(key, parseValue());
+          } while (consume(','));
+          require('}');
+          return result;
+        } else if (c == '[') {
+          ++pos;
+          Json result(Json::array());
+          if (consume(']'))
+            return result;
+          do {
+            result.push(parseValue());
+          } while (consume(','));
+          require(']');
+          return result;
+        } else if (c == '"') {
+          return parseString();
+        } else if (consumeWord("true")) {
+          return true;
+        } else if (consumeWord("false")) {
+          return false;
+        } else if (consumeWord("null")) {
+          return {};
+        } else {
+          return parseNumber();
+        }
+      }
+
+      Json parseDocument() {
+        Json result(parseValue());
+        skipSpace();
+        if (pos != text.size())
+          fail("trailing characters");
+        return result;
+      }
+    };
+
+    void writeString(std::ostream &out, const std::string &x) {
+      out << '"';
+      for (char c : x) {
+        switch (c) {
+          case '"': out << "\\\""; break;
+          case '\\': out << "\\\\"; break;
+          case '\n': out << "\\n"; break;
+          case '\r': out << "\\r"; break;
+          case '\t': out << "\\t"; break;
+          default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+              const char *digits("0123456789abcdef");
+              out << "\\u00" << digits[c >> 4] << digits[c & 15];
+            } else {
+              out << c;
+            }
+        }
+      }
+      out << '"';
+    }
+
+    void writeIndent(std::ostream &out, int indent) {
+      out << '\n';
+      for (int i{}; i < indent; ++i)
+        out << "  ";
+    }
+  }
+
+  Json Json::parse(const std::string &text) {
+    return Parser(text).parseDocument();
+  }
+
+  Json Json::load(const std::string &path) {
+    std::ifstream in(path);
+    if (!in)
+      throw std::runtime_error("can't open " + path);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    try {
+      return parse(buffer.str());
+    } catch (const std::runtime_error &e) {
+      throw std::runtime_error(path + ": " + e.what());
+    }
+  }
+
+  void Json::expect(Type expected) const {
+    if (type != expected)
+      throw std::runtime_error(std::string("JSON: expected ") + typeNames[static_cast<int>(expected)]
+        + ", got " + typeNames[static_cast<int>(type)]);
+  }
+
+  bool Json::asBool() const {
+    expect(Type::Bool);
+    return boolean;
+  }
+
+  double Json::asNumber() const {
+    expect(Type::Number);
+    return number;
+  }
+
+  int Json::asInt() const {
+    expect(Type::Number);
+    if (number != std::floor(number) || std::abs(number) > 2147483647.0)
+      throw std::runtime_error("JSON: expected an integer, got " + std::to_string(number));
+    return static_cast<int>(number);
+  }
+
+  const std::string &Json::asString() const {
+    expect(Type::String);
+    return string;
+  }
+
+  const std::vector<Json> &Json::asArray() const {
+    expect(Type::Array);
+    return elements;
+  }
+
+  const std::vector<std::pair<std::string, Json>> &Json::asObject() const {
+    expect(Type::Object);
+    return members;
+  }
+
+  const Json *Json::find(const std::string &key) const {
+    if (type != Type::Object)
+      return nullptr;
+    for (auto &[name, value] : members)
+      if (name == key)
+        return &value;
+    return nullptr;
+  }
+
+  const Json &Json::operator[](const std::string &key) const {
+    expect(Type::Object);
+    const Json *result(find(key));
+    if (!result)
+      throw std::runtime_error("JSON: missing \"" + key + "\"");
+    return *result;
+  }
+
+  Json &Json::set(const std::string &key, Json value) {
+    expect(Type::Object);
+    for (auto &[name, old] : members) {
+      if (name == key) {
+        old = std::move(value);
+        return *this;
+      }
+    }
+    members.emplace_back(key, std::move(value));
+    return *this;
+  }
+
+  Json &Json::push(Json value) {
+    expect(Type::Array);
+    elements.emplace_back(std::move(value));
+    return *this;
+  }
+
+  void Json::write(std::ostream &out, int indent) const {
+    switch (type) {
+      case Type::Null:
+        out << "null";
+        break;
+      case Type::Bool:
+        out << (boolean ? "true" : "false");
+        break;
+      case Type::Number:
+        if (!std::isfinite(number)) {
+          out << "null";
+        } else if (number == std::floor(number) && std::abs(number) < 1e15) {
+          out << static_cast<long long>(number);
+        } else {
+          auto precision(out.precision(17));
+          out << number;
+          out.precision(precision);
+        }
+        break;
+      case Type::String:
+        writeString(out, string);
+        break;
+      case Type::Array: {
+        // Arrays of scalars, such as tile states, stay on one line.
+        bool isFlat(true);
+        for (auto &i : elements)
+          isFlat &= i.type != Type::Array && i.type != Type::Object;
+        out << '[';
+        for (std::size_t i{}; i < elements.size(); ++i) {
+          if (i)
+            out << (isFlat ? ", " : ",");
+          if (!isFlat)
+            writeIndent(out, indent + 1);
+          elements[i].write(out, indent + 1);
+        }
+        if (!isFlat && !elements.empty())
+          writeIndent(out, indent);
+        out << ']';
+        break;
+      }
+      case Type::Object:
+        out << '{';
+        for (std::size_t i{}; i < members.size(); ++i) {
+          if (i)
+            out << ',';
+          writeIndent(out, indent + 1);
+          writeString(out, members[i].first);
+          out << ": ";
+          members[i].second.write(out, indent + 1);
+        }
+        if (!members.empty())
+          writeIndent(out, indent);
+        out << '}';
+        break;
+    }
+  }
+
+  std::string Json::dump() const {
+    std::ostringstream out;
+    write(out);
+    return out.str();
+  }
+}
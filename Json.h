@@ -0,0 +1,56 @@
+#ifndef _JSON_H_
+#define _JSON_H_
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Common {
+  // Just enough JSON for configuration files and result output. Objects keep their insertion order.
+  // Parsing and type errors throw std::runtime_error.
+  class Json {
+  public:
+    enum class Type { Null, Bool, Number, String, Array, Object };
+  private:
+    Type type;
+    bool boolean{};
+    double number{};
+    std::string string;
+    std::vector<Json> elements;
+    std::vector<std::pair<std::string, Json>> members;
+    void expect(Type expected) const;
+  public:
+    Json() :type(Type::Null) {}
+    Json(bool x) :type(Type::Bool), boolean(x) {}
+    Json(int x) :type(Type::Number), number(x) {}
+    Json(long long x) :type(Type::Number), number(static_cast<double>(x)) {}
+    Json(double x) :type(Type::Number), number(x) {}
+    Json(const char *x) :type(Type::String), string(x) {}
+    Json(std::string x) :type(Type::String), string(std::move(x)) {}
+    static Json array() { Json result; result.type = Type::Array; return result; }
+    static Json object() { Json result; result.type = Type::Object; return result; }
+    static Json parse(const std::string &text);
+    static Json load(const std::string &path);
+
+    Type getType() const { return type; }
+    bool isNull() const { return type == Type::Null; }
+    bool asBool() const;
+    double asNumber() const;
+    // Throws unless the number is integral.
+    int asInt() const;
+    const std::string &asString() const;
+    const std::vector<Json> &asArray() const;
+    const std::vector<std::pair<std::string, Json>> &asObject() const;
+    // Returns nullptr if this is not an object or has no such member.
+    const Json *find(const std::string &key) const;
+    // Throws if the member is missing.
+    const Json &operator[](const std::string &key) const;
+
+    Json &set(const std::string &key, Json value);
+    Json &push(Json value);
+    void write(std::ostream &out, int indent = 0) const;
+    std::string dump() const;
+  };
+}
+
+#endif
@@ -0,0 +1,152 @@
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include "Log.h"
+
+namespace Common {
+  namespace {
+    static_assert(!(logCapacity & (logCapacity - 1)), "the queue indexes with a mask");
+
+    // Bounded MPMC queue after Vyukov, used with a single consumer: a slot's sequence tells whether it is free for
+    // the writer at that position (sequence == position) or holds a record for the reader (sequence == position + 1).
+    class LogQueue {
+      struct Slot {
+        std::atomic<std::size_t> sequence;
+        LogRecord record;
+      };
+      Slot slots[logCapacity];
+      std::atomic<std::size_t> writePos;
+      std::size_t readPos;
+    public:
+      std::atomic<int> level;
+      std::atomic<long long> nDropped;
+
+      LogQueue() :writePos(), readPos(), level(static_cast<int>(LogLevel::Warn)), nDropped() {
+        for (int i{}; i < logCapacity; ++i)
+          slots[i].sequence.store(i, std::memory_order_relaxed);
+      }
+
+      void push(LogLevel level, const char *format, va_list args) {
+        std::size_t pos(writePos.load(std::memory_order_relaxed));
+        Slot *slot;
+        while (true) {
+          slot = &slots[pos & (logCapacity - 1)];
+          std::size_t sequence(slot->sequence.load(std::memory_order_acquire));
+          auto diff(static_cast<std::ptrdiff_t>(sequence - pos));
+          if (!diff) {
+            if (writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+              break;
+          } else if (diff < 0) {
+            nDropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+          } else {
+            pos = writePos.load(std::memory_order_relaxed);
+          }
+        }
+        slot->record.level = level;
+        std::vsnprintf(slot->record.text, maxLogLength, format, args);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+      }
+
+      bool pop(LogRecord &record) {
+        Slot &slot(slots[readPos & (logCapacity - 1)]);
+        if (slot.sequence.load(std::memory_order_acquire) != readPos + 1)
+          return false;
+        record = slot.record;
+        slot.sequence.store(readPos + logCapacity, std::memory_order_release);
+        ++readPos;
+        return true;
+      }
+    };
+
+    LogQueue &getQueue() {
+      static LogQueue queue;
+      return queue;
+    }
+
+    constexpr const char *logLevelNames[] { "debug", "info", "warn", "error", "off" };
+  }
+
+  const char *getLogLevelName(LogLevel level) {
+    return logLevelNames[static_cast<int>(level)];
+  }
+
+  bool parseLogLevel(const char *name, LogLevel &level) {
+    for (int i{}; i <= static_cast<int>(LogLevel::Off); ++i) {
+      if (!std::strcmp(name, logLevelNames[i])) {
+        level = static_cast<LogLevel>(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void setLogLevel(LogLevel level) {
+    getQueue().level.store(static_cast<int>(level), std::memory_order_relaxed);
+  }
+
+  LogLevel getLogLevel() {
+    return static_cast<LogLevel>(getQueue().level.load(std::memory_order_relaxed));
+  }
+
+  void log(LogLevel level, const char *format, ...) {
+    LogQueue &queue(getQueue());
+    if (static_cast<int>(level) < queue.level.load(std::memory_order_relaxed) || level == LogLevel::Off)
+      return;
+    va_list args;
+    va_start(args, format);
+    queue.push(level, format, args);
+    va_end(args);
+  }
+
+  bool popLog(LogRecord &record) {
+    return getQueue().pop(record);
+  }
+
+  int drainLog(std::ostream &out) {
+    LogRecord record;
+    int result{};
+    while (popLog(record)) {
+      out << '[' << getLogLevelName(record.level) << "] " << record.text << '\n';
+      ++result;
+    }
+    if (result)
+      out.flush();
+    return result;
+  }
+
+  long long getNDroppedLogs() {
+    return getQueue().nDropped.load(std::memory_order_relaxed);
+  }
+
+#if FISSION_THREADS
+  LogWriter::LogWriter(std::ostream &out) :out(out), stopping() {
+    thread = std::thread([this] {
+      std::unique_lock lock(mutex);
+      while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(100));
+        drainLog(this->out);
+      }
+    });
+  }
+
+  LogWriter::~LogWriter() {
+    {
+      std::lock_guard lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+    drainLog(out);
+  }
+#else
+  LogWriter::LogWriter(std::ostream &out) :out(out) {}
+
+  LogWriter::~LogWriter() {
+    drainLog(out);
+  }
+#endif
+}
@@ -0,0 +1,60 @@
+#ifndef _LOG_H_
+#define _LOG_H_
+#include <ostream>
+#include "Platform.h"
+#if FISSION_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace Common {
+  enum class LogLevel { Debug, Info, Warn, Error, Off };
+
+  constexpr int maxLogLength(128), logCapacity(1024);
+
+  struct LogRecord {
+    LogLevel level;
+    char text[maxLogLength];
+  };
+
+  const char *getLogLevelName(LogLevel level);
+  // Inverse of getLogLevelName; returns false for an unknown name.
+  bool parseLogLevel(const char *name, LogLevel &level);
+
+  // The log is process-wide: a bounded lock-free queue that any thread may write to and one consumer drains.
+  // Records below the level are dropped before formatting, so a run with the level at Off does no formatting or I/O.
+  // When the queue is full, new records are dropped and counted rather than blocking the writer.
+  void setLogLevel(LogLevel level);
+  LogLevel getLogLevel();
+  // printf-style; longer messages are truncated.
+  void log(LogLevel level, const char *format, ...)
+#ifdef __GNUC__
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+  // Single consumer: either a LogWriter or the host, never both.
+  bool popLog(LogRecord &record);
+  // Writes the queued records as "[level] text" lines and returns how many there were.
+  int drainLog(std::ostream &out);
+  long long getNDroppedLogs();
+
+  // Drains the log to a stream on a background thread until destroyed, then drains what's left.
+  // Builds without threads only drain on destruction, so the host has to call drainLog itself in between.
+  class LogWriter {
+    std::ostream &out;
+#if FISSION_THREADS
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+#endif
+  public:
+    explicit LogWriter(std::ostream &out);
+    LogWriter(const LogWriter &) = delete;
+    LogWriter &operator=(const LogWriter &) = delete;
+    ~LogWriter();
+  };
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include "Differential.h"
+#include "Driver.h"
+#include "Log.h"
+#include "Trace.h"
+
+static int usage() {
+  std::cerr << "usage: FissionOpt <config.json> [--threads N] [--output results.json] [--log-level debug|info|warn|error|off]\n"
+    "                [--trace trace.json] [--trace-period N]\n"
+    "       FissionOpt diff [--mode fission|overhaul|both] [--backend reused] [--cases N] [--mutations N]\n"
+    "                       [--max-size N] [--seed N] [--output mismatch.json]" << std::endl;
+  return 2;
+}
+
+// Checks evaluator backends against the reference evaluators and writes a shrunk reproducer on mismatch.
+static int diff(int argc, char **argv) {
+  Differential::Options options;
+  std::string mode("both"), backendName("reused"), output("mismatch.json");
+  for (int i(2); i < argc; ++i) {
+    if (i + 1 >= argc)
+      return usage();
+    if (!std::strcmp(argv[i], "--mode"))
+      mode = argv[++i];
+    else if (!std::strcmp(argv[i], "--backend"))
+      backendName = argv[++i];
+    else if (!std::strcmp(argv[i], "--cases"))
+      options.nCases = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "--mutations"))
+      options.nMutations = std::atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "--max-size"))
+      options.maxSize = std::max(1, std::atoi(argv[++i]));
+    else if (!std::strcmp(argv[i], "--seed"))
+      options.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+    else if (!std::strcmp(argv[i], "--output"))
+      output = argv[++i];
+    else
+      return usage();
+  }
+  if (mode != "fission" && mode != "overhaul" && mode != "both")
+    return usage();
+
+  Common::Json report;
+  bool found{};
+  if (mode != "overhaul") {
+    for (auto &backend : Differential::getFissionBackends()) {
+      if (backend.name != backendName)
+        continue;
+      found = true;
+      report = Differential::checkFission(backend, options);
+    }
+  }
+  if (report.isNull() && mode != "fission") {
+    for (auto &backend : Differential::getOverhaulBackends()) {
+      if (backend.name != backendName)
+        continue;
+      found = true;
+      report = Differential::checkOverhaul(backend, options);
+    }
+  }
+  if (!found) {
+    std::cerr << "error: no backend named " << backendName << std::endl;
+    return 2;
+  }
+  if (report.isNull()) {
+    std::cout << backendName << ": " << options.nCases << " cases matched" << std::endl;
+    return 0;
+  }
+  std::cout << backendName << ": mismatch in " << report["field"].asString() << ": reference "
+    << report["reference"].asString() << ", candidate " << report["candidate"].asString()
+    << "; reproducer written to " << output << std::endl;
+  std::ofstream out(output);
+  report.write(out);
+  out << std::endl;
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 2 && !std::strcmp(argv[1], "diff"))
+    return diff(argc, argv);
+  const char *configPath{};
+  const char *threads{}, *output{}, *tracePath{};
+  int tracePeriod(1000);
+  Common::LogLevel logLevel(Common::LogLevel::Warn);
+  for (int i(1); i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--threads") && i + 1 < argc)
+      threads = argv[++i];
+    else if (!std::strcmp(argv[i], "--log-level") && i + 1 < argc && Common::parseLogLevel(argv[i + 1], logLevel))
+      ++i;
+    else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+      output = argv[++i];
+    else if (!std::strcmp(argv[i], "--trace") && i + 1 < argc)
+      tracePath = argv[++i];
+    else if (!std::strcmp(argv[i], "--trace-period") && i + 1 < argc)
+      tracePeriod = std::max(1, std::atoi(argv[++i]));
+    else if (argv[i][0] != '-' && !configPath)
+      configPath = argv[i];
+    else
+      return usage();
+  }
+  if (!configPath)
+    return usage();
+  Common::setLogLevel(logLevel);
+  Common::LogWriter logWriter(std::clog);
+  try {
+    Driver::Config config(Driver::parseConfig(Common::Json::load(configPath)));
+    if (threads)
+      config.nThreads = std::max(1, std::atoi(threads));
+    if (output)
+      config.output = output;
+    if (tracePath)
+      Common::startTrace(tracePeriod);
+    Common::Json results(Driver::runJobs(config));
+    if (tracePath && !Common::stopTrace(tracePath))
+      throw std::runtime_error(std::string("can't write ") + tracePath);
+    std::ofstream out(config.output);
+    if (!out)
+      throw std::runtime_error("can't write " + config.output);
+    results.write(out);
+    out << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << "error: " << e.what() << std::endl;
+    return 1;
+  }
+}
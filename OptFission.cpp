@@ -1,5 +1,7 @@
+#include <stdexcept>
 #include <xtensor/xview.hpp>
 #include "FissionNet.h"
+#include "Log.h"
 
 namespace Fission {
   void Opt::restart() {
@@ -7,6 +9,8 @@ namespace Fission {
     std::copy(settings.limit, settings.limit + Air, parent.limit);
     parent.state = xt::broadcast<int>(Air,
       {settings.sizeX, settings.sizeY, settings.sizeZ});
+    std::fill(parent.tileCounts, parent.tileCounts + Air + 1, 0);
+    parent.tileCounts[Air] = settings.sizeX * settings.sizeY * settings.sizeZ;
     for (auto &[x, y, z] : allowedCoords) {
       int nSym(getNSym(x, y, z));
       allowedTiles.clear();
@@ -20,27 +24,70 @@ namespace Fission {
       setTileWithSym(parent, x, y, z, newTile);
     }
     evaluator.run(parent.state, parent.value);
+    ++counters.nEvaluations;
   }
 
-  Opt::Opt(const Settings &settings, bool useNet)
+  void Opt::restartFrom(const xt::xtensor<int, 3> &initial) {
+    auto &shape(initial.shape());
+    if (static_cast<int>(shape[0]) != settings.sizeX || static_cast<int>(shape[1]) != settings.sizeY
+      || static_cast<int>(shape[2]) != settings.sizeZ)
+      throw std::runtime_error("initial design doesn't match the reactor size");
+    for (int tile : initial)
+      if (tile < 0 || tile > Air)
+        throw std::runtime_error("initial design has an unknown tile");
+    // Same as restart, but taking the tiles from the design while the limits allow.
+    std::copy(settings.limit, settings.limit + Air, parent.limit);
+    parent.state = xt::broadcast<int>(Air,
+      {settings.sizeX, settings.sizeY, settings.sizeZ});
+    std::fill(parent.tileCounts, parent.tileCounts + Air + 1, 0);
+    parent.tileCounts[Air] = settings.sizeX * settings.sizeY * settings.sizeZ;
+    for (auto &[x, y, z] : allowedCoords) {
+      int tile(initial(x, y, z)), nSym(getNSym(x, y, z));
+      if (tile == Air || (parent.limit[tile] >= 0 && parent.limit[tile] < nSym))
+        continue;
+      parent.limit[tile] -= nSym;
+      setTileWithSym(parent, x, y, z, tile);
+    }
+    int nChanged{};
+    auto it(initial.begin());
+    for (int tile : parent.state)
+      nChanged += tile != *it++;
+    if (nChanged)
+      Common::log(Common::LogLevel::Warn, "initial design: %d tiles changed to fit the limits and symmetry", nChanged);
+    evaluator.run(parent.state, parent.value);
+    ++counters.nEvaluations;
+  }
+
+  Opt::Opt(const Settings &settings, bool useNet, unsigned seed)
+    :Opt(settings, useNet, xt::xtensor<int, 3>(), seed) {}
+
+  Opt::Opt(const Settings &settings, bool useNet, const xt::xtensor<int, 3> &initial, unsigned seed)
     :settings(settings), evaluator(settings),
     nEpisode(), nStage(), nIteration(), nConverge(),
     maxConverge(std::min(7 * 7 * 7, settings.sizeX * settings.sizeY * settings.sizeZ) * 16),
-    infeasibilityPenalty(), bestChanged(true), redrawNagle(), lossHistory(nLossHistory), lossChanged() {
+    nSteps(), lastImprovement(), infeasibilityPenalty(), rng(seed), bestChanged(true), redrawNagle(), lossHistory(nLossHistory), lossChanged(),
+    startTime(Common::Clock::now()), profiling(),
+    maxPolishSweeps(defaultPolishSweeps), nPolishSweeps(), polishIndex(), polishSwaps(), polishImproved() {
     for (int x(settings.symX ? settings.sizeX / 2 : 0); x < settings.sizeX; ++x)
       for (int y(settings.symY ? settings.sizeY / 2 : 0); y < settings.sizeY; ++y)
         for (int z(settings.symZ ? settings.sizeZ / 2 : 0); z < settings.sizeZ; ++z)
           allowedCoords.emplace_back(x, y, z);
 
-    restart();
+    if (initial.size())
+      restartFrom(initial);
+    else
+      restart();
     if (useNet) {
       net = std::make_unique<Net>(*this);
       net->appendTrajectory(parent);
     }
     parentFitness = currentFitness(parent);
 
+    std::copy(settings.limit, settings.limit + Air, best.limit);
     best.state = xt::broadcast<int>(Air,
       {settings.sizeX, settings.sizeY, settings.sizeZ});
+    std::fill(best.tileCounts, best.tileCounts + Air + 1, 0);
+    best.tileCounts[Air] = settings.sizeX * settings.sizeY * settings.sizeZ;
     evaluator.run(best.state, best.value);
   }
 
@@ -61,9 +108,8 @@ namespace Fission {
 
   double Opt::currentFitness(const Sample &x) {
     if (nStage == StageInfer) {
+      ++counters.nInferences;
       return net->infer(x);
-    } else if (nStage == StageTrain) {
-      return 0.0;
     } else if (feasible(x.value)) {
       return rawFitness(x.value);
     } else {
@@ -83,30 +129,36 @@ namespace Fission {
   }
 
   void Opt::setTileWithSym(Sample &sample, int x, int y, int z, int tile) {
-    sample.state(x, y, z) = tile;
+    auto set([&](int x, int y, int z) {
+      int &slot(sample.state(x, y, z));
+      --sample.tileCounts[slot];
+      ++sample.tileCounts[tile];
+      slot = tile;
+    });
+    set(x, y, z);
     if (settings.symX) {
-      sample.state(settings.sizeX - x - 1, y, z) = tile;
+      set(settings.sizeX - x - 1, y, z);
       if (settings.symY) {
-        sample.state(x, settings.sizeY - y - 1, z) = tile;
-        sample.state(settings.sizeX - x - 1, settings.sizeY - y - 1, z) = tile;
+        set(x, settings.sizeY - y - 1, z);
+        set(settings.sizeX - x - 1, settings.sizeY - y - 1, z);
         if (settings.symZ) {
-          sample.state(x, y, settings.sizeZ - z - 1) = tile;
-          sample.state(settings.sizeX - x - 1, y, settings.sizeZ - z - 1) = tile;
-          sample.state(x, settings.sizeY - y - 1, settings.sizeZ - z - 1) = tile;
-          sample.state(settings.sizeX - x - 1, settings.sizeY - y - 1, settings.sizeZ - z - 1) = tile;
+          set(x, y, settings.sizeZ - z - 1);
+          set(settings.sizeX - x - 1, y, settings.sizeZ - z - 1);
+          set(x, settings.sizeY - y - 1, settings.sizeZ - z - 1);
+          set(settings.sizeX - x - 1, settings.sizeY - y - 1, settings.sizeZ - z - 1);
         }
       } else if (settings.symZ) {
-        sample.state(x, y, settings.sizeZ - z - 1) = tile;
-        sample.state(settings.sizeX - x - 1, y, settings.sizeZ - z - 1) = tile;
+        set(x, y, settings.sizeZ - z - 1);
+        set(settings.sizeX - x - 1, y, settings.sizeZ - z - 1);
       }
     } else if (settings.symY) {
-      sample.state(x, settings.sizeY - y - 1, z) = tile;
+      set(x, settings.sizeY - y - 1, z);
       if (settings.symZ) {
-        sample.state(x, y, settings.sizeZ - z - 1) = tile;
-        sample.state(x, settings.sizeY - y - 1, settings.sizeZ - z - 1) = tile;
+        set(x, y, settings.sizeZ - z - 1);
+        set(x, settings.sizeY - y - 1, settings.sizeZ - z - 1);
       }
     } else if (settings.symZ) {
-      sample.state(x, y, settings.sizeZ - z - 1) = tile;
+      set(x, y, settings.sizeZ - z - 1);
     }
   }
 
@@ -125,25 +177,156 @@ namespace Fission {
       sample.limit[newTile] -= nSym;
     setTileWithSym(sample, x, y, z, newTile);
     evaluator.run(sample.state, sample.value);
+    ++counters.nEvaluations;
+  }
+
+  void Opt::clearInvalidTiles(Sample &sample) {
+    for (auto &[x, y, z] : sample.value.invalidTiles) {
+      int &tile(sample.state(x, y, z));
+      if (tile == Air)
+        continue;
+      if (sample.limit[tile] >= 0)
+        ++sample.limit[tile];
+      --sample.tileCounts[tile];
+      ++sample.tileCounts[Air];
+      tile = Air;
+    }
+  }
+
+  void Opt::offerParent() {
+    if (!feasible(parent.value) || rawFitness(parent.value) <= rawFitness(best.value))
+      return;
+    best = parent;
+    lastImprovement = nSteps;
+    clearInvalidTiles(best);
+    bestChanged = true;
+  }
+
+  bool Opt::polishTile(int i) {
+    auto [x, y, z] = allowedCoords[i];
+    int nSym(getNSym(x, y, z)), oldTile(parent.state(x, y, z)), bestTile(oldTile);
+    auto place([&](int tile) {
+      int current(parent.state(x, y, z));
+      if (current != Air)
+        parent.limit[current] += nSym;
+      if (tile != Air)
+        parent.limit[tile] -= nSym;
+      setTileWithSym(parent, x, y, z, tile);
+    });
+    // polishValue holds the evaluation of the best tile so far, starting with the parent's.
+    std::swap(polishValue, parent.value);
+    for (int tile{}; tile <= Air; ++tile) {
+      if (tile == oldTile || (tile != Air && parent.limit[tile] >= 0 && parent.limit[tile] < nSym))
+        continue;
+      place(tile);
+      evaluator.run(parent.state, parent.value);
+      ++counters.nEvaluations;
+      offerParent();
+      // The parent is feasible, so its fitness is the raw one, and the polish keeps it feasible.
+      double fitness(rawFitness(parent.value));
+      if (feasible(parent.value) && fitness > parentFitness) {
+        parentFitness = fitness;
+        bestTile = tile;
+        std::swap(polishValue, parent.value);
+      }
+      place(oldTile);
+    }
+    place(bestTile);
+    std::swap(polishValue, parent.value);
+    return bestTile != oldTile;
+  }
+
+  bool Opt::polishSwap(int i, int j) {
+    auto [x1, y1, z1] = allowedCoords[i];
+    auto [x2, y2, z2] = allowedCoords[j];
+    int tile1(parent.state(x1, y1, z1)), tile2(parent.state(x2, y2, z2));
+    // Equal symmetry keeps the limits as they are.
+    if (tile1 == tile2 || getNSym(x1, y1, z1) != getNSym(x2, y2, z2))
+      return false;
+    std::swap(polishValue, parent.value);
+    setTileWithSym(parent, x1, y1, z1, tile2);
+    setTileWithSym(parent, x2, y2, z2, tile1);
+    evaluator.run(parent.state, parent.value);
+    ++counters.nEvaluations;
+    offerParent();
+    double fitness(rawFitness(parent.value));
+    if (feasible(parent.value) && fitness > parentFitness) {
+      parentFitness = fitness;
+      return true;
+    }
+    setTileWithSym(parent, x1, y1, z1, tile1);
+    setTileWithSym(parent, x2, y2, z2, tile2);
+    std::swap(polishValue, parent.value);
+    return false;
+  }
+
+  bool Opt::polishStep() {
+    if (!maxPolishSweeps)
+      return false;
+    if (polishIndex == static_cast<int>(allowedCoords.size())) {
+      ++nPolishSweeps;
+      bool isDone(!polishImproved || nPolishSweeps == maxPolishSweeps);
+      polishIndex = 0;
+      polishImproved = false;
+      if (isDone) {
+        nPolishSweeps = 0;
+        return false;
+      }
+    }
+    int i(polishIndex++);
+    bool improved(polishTile(i));
+    if (polishSwaps)
+      for (int j(i + 1); j < static_cast<int>(allowedCoords.size()); ++j)
+        improved |= polishSwap(i, j);
+    if (improved) {
+      polishImproved = true;
+      if (net)
+        net->appendTrajectory(parent);
+    }
+    return true;
+  }
+
+  void Opt::addLoss(double loss) {
+    for (int i{}; i < nLossHistory - 1; ++i)
+      lossHistory[i] = lossHistory[i + 1];
+    lossHistory[nLossHistory - 1] = loss;
+    lossChanged = true;
+    ++counters.nTrainIterations;
+  }
+
+  void Opt::collectLosses() {
+    trainer.drainLosses(newLosses);
+    for (double loss : newLosses)
+      addLoss(loss);
+    nIteration = trainer.poll() ? 0 : trainer.getNRemaining();
   }
 
   void Opt::step() {
+    // The whole step is charged to the stage it started in.
+    Common::ScopedTimer timer(!profiling ? nullptr : nStage == StageTrain ? &counters.trainSeconds
+      : nStage == StageInfer ? &counters.inferSeconds : &counters.rolloutSeconds);
+    Common::TraceScope trace(nStage == StageTrain ? "train step" : nStage == StageInfer ? "infer step" : "rollout step");
+    ++nSteps;
     if (nStage == StageTrain) {
+      if (Common::Trainer::isAsync)
+        collectLosses();
       if (!nIteration) {
         nStage = StageInfer;
+        nConverge = 0;
         parentFitness = net->infer(parent);
         inferenceFailed = true;
-      } else {
-        for (int i{}; i < nLossHistory - 1; ++i)
-          lossHistory[i] = lossHistory[i + 1];
-        lossHistory[nLossHistory - 1] = net->train();
-        lossChanged = true;
+      } else if (!Common::Trainer::isAsync) {
+        addLoss(net->train());
         --nIteration;
         return;
       }
     }
 
-    if (nConverge == maxConverge) {
+    if (nStage != StageTrain && nConverge == maxConverge) {
+      // Only the feasible design a rollout ends on is polished, before it's recorded; infeasible stages escalate
+      //   the penalty instead, and the surrogate's fitness is too noisy to polish on.
+      if (nStage >= 0 && feasible(parent.value) && polishStep())
+        return;
       nIteration = 0;
       nConverge = 0;
       if (nStage == StageInfer) {
@@ -159,6 +342,9 @@ namespace Fission {
           nStage = StageTrain;
           net->finishTrajectory(feasible(parent.value) ? rawFitness(parent.value) : 0.0);
           nIteration = (net->getTrajectoryLength() * nEpoch + nMiniBatch - 1) / nMiniBatch;
+          // While the network trains in the background, the search keeps climbing on the exact fitness.
+          if (Common::Trainer::isAsync)
+            trainer.start(nIteration, [this] { return net->train(); });
           return;
         } else {
           nStage = 0;
@@ -182,14 +368,27 @@ namespace Fission {
       xDist(0, settings.sizeX - 1),
       yDist(0, settings.sizeY - 1),
       zDist(0, settings.sizeZ - 1);
+    for (auto &child : children) {
+      child.state = parent.state;
+      std::copy(parent.limit, parent.limit + Air, child.limit);
+      std::copy(parent.tileCounts, parent.tileCounts + Air + 1, child.tileCounts);
+      mutateAndEvaluate(child, xDist(rng), yDist(rng), zDist(rng));
+    }
+    counters.nProposals += children.size();
+    xt::xtensor<double, 1> fitnesses;
+    if (nStage == StageInfer) {
+      fitnesses = net->inferBatch(children.data(), static_cast<int>(children.size()));
+      counters.nInferences += children.size();
+    } else {
+      fitnesses = xt::empty<double>({children.size()});
+      for (int i{}; i < static_cast<int>(children.size()); ++i)
+        fitnesses(i) = currentFitness(children[i]);
+    }
     int bestChild;
     double bestFitness;
     for (int i{}; i < children.size(); ++i) {
       auto &child(children[i]);
-      child.state = parent.state;
-      std::copy(parent.limit, parent.limit + Air, child.limit);
-      mutateAndEvaluate(child, xDist(rng), yDist(rng), zDist(rng));
-      double fitness(currentFitness(child));
+      double fitness(fitnesses(i));
       if (!i || fitness > bestFitness) {
         bestChild = i;
         bestFitness = fitness;
@@ -208,14 +407,16 @@ namespace Fission {
           inferenceFailed = false;
       }
       std::swap(parent, child);
-      if (net && nStage != StageInfer)
+      ++counters.nAccepted;
+      if (net && nStage >= 0)
         net->appendTrajectory(parent);
     }
     ++nConverge;
-    ++nIteration;
+    if (nStage != StageTrain)
+      ++nIteration;
     if (bestChangedLocal) {
-      for (auto &[x, y, z] : best.value.invalidTiles)
-        best.state(x, y, z) = Air;
+      lastImprovement = nSteps;
+      clearInvalidTiles(best);
       bestChanged = true;
     }
   }
@@ -223,10 +424,65 @@ namespace Fission {
   void Opt::stepInteractive() {
     int dim(settings.sizeX * settings.sizeY * settings.sizeZ);
     int n(std::min(interactiveMin, (interactiveScale + dim - 1) / dim));
-    for (int i{}; i < (nStage == StageTrain ? interactiveNet : nStage == StageInfer ? interactiveNet * nMiniBatch / 4 : n); ++i) {
+    bool isTraining(nStage == StageTrain && !Common::Trainer::isAsync);
+    for (int i{}; i < (isTraining ? interactiveNet : nStage == StageInfer ? interactiveNet * nMiniBatch / 4 : n); ++i) {
+      step();
+      ++redrawNagle;
+    }
+  }
+
+  int Opt::stepFor(double microseconds) {
+    return pacer.run(microseconds * 1e-6, [this] {
       step();
       ++redrawNagle;
+    }, [this] { return nStage == StageTrain ? 1 : nStage == StageInfer ? 2 : 0; });
+  }
+
+  RunResult Opt::run(const Common::Budget &budget, const std::function<void(const Sample &)> &onImprovement) {
+    Common::BudgetTracker tracker(budget, nSteps, counters.nEvaluations, lastImprovement);
+    long long reported(lastImprovement);
+    Common::StopReason stopReason;
+    while (!tracker.check(nSteps, counters.nEvaluations, lastImprovement, rawFitness(best.value), stopReason)) {
+      step();
+      if (onImprovement && lastImprovement != reported) {
+        reported = lastImprovement;
+        onImprovement(best);
+      }
+    }
+    return {stopReason, best};
+  }
+
+  bool Opt::setReplayFile(const std::string &path) {
+    // The pool can't move under a running training thread.
+    if (!net || nStage == StageTrain)
+      return false;
+    return net->openReplayFile(path);
+  }
+
+  void Opt::setProfiling(bool enabled) {
+    profiling = enabled;
+    evaluator.setProfile(enabled ? &counters.phases : nullptr);
+  }
+
+  void Opt::setPolish(int maxSweeps, bool swaps) {
+    maxPolishSweeps = std::max(0, maxSweeps);
+    nPolishSweeps = 0;
+    polishIndex = 0;
+    polishSwaps = swaps;
+    polishImproved = false;
+  }
+
+  Common::Counters Opt::getCounters() const {
+    Common::Counters result(counters);
+    result.seconds = std::chrono::duration<double>(Common::Clock::now() - startTime).count();
+    result.nSteps = nSteps;
+    if (net) {
+      auto &pool(net->getPool());
+      result.poolSize = pool.getSize();
+      result.nPoolAppends = pool.getNAppends();
+      result.nPoolDuplicates = pool.getNDuplicates();
     }
+    return result;
   }
 
   bool Opt::needsRedrawBest() {
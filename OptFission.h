@@ -2,11 +2,17 @@
 #define _OPT_FISSION_H_
 #include <random>
 #include <memory>
+#include <functional>
+#include "Budget.h"
+#include "Pacer.h"
+#include "Trainer.h"
 #include "Fission.h"
 
 namespace Fission {
   struct Sample {
     int limit[Air];
+    // Histogram of state, kept up to date by Opt::setTileWithSym and Opt::clearInvalidTiles.
+    int tileCounts[Air + 1];
     xt::xtensor<int, 3> state;
     Evaluation value;
   };
@@ -17,6 +23,12 @@ namespace Fission {
   };
 
   constexpr int interactiveMin(1024), interactiveScale(327680), interactiveNet(16), nLossHistory(256);
+  constexpr int defaultPolishSweeps(0);
+
+  struct RunResult {
+    Common::StopReason stopReason;
+    Sample best;
+  };
 
   class Net;
 
@@ -28,6 +40,7 @@ namespace Fission {
     std::vector<int> allowedTiles;
     int nEpisode, nStage, nIteration;
     int nConverge, maxConverge;
+    long long nSteps, lastImprovement;
     double infeasibilityPenalty;
     double parentFitness;
     Sample parent, best;
@@ -37,19 +50,49 @@ namespace Fission {
     bool inferenceFailed;
     bool bestChanged;
     int redrawNagle;
-    std::vector<double> lossHistory;
+    std::vector<double> lossHistory, newLosses;
     bool lossChanged;
+    Common::Counters counters;
+    Common::Clock::time_point startTime;
+    bool profiling;
+    // Polishing a converged rollout stage: sweeps done, the next position and whether this sweep improved the parent.
+    int maxPolishSweeps, nPolishSweeps, polishIndex;
+    bool polishSwaps, polishImproved;
+    Evaluation polishValue;
+    // Slots are rollout, train and infer.
+    Common::Pacer<3> pacer;
+    // Declared after net so that a running training thread is joined before the network is destroyed.
+    Common::Trainer trainer;
     void restart();
+    void restartFrom(const xt::xtensor<int, 3> &initial);
     bool feasible(const Evaluation &x);
     double rawFitness(const Evaluation &x);
     double currentFitness(const Sample &x);
     int getNSym(int x, int y, int z);
     void setTileWithSym(Sample &sample, int x, int y, int z, int tile);
     void mutateAndEvaluate(Sample &sample, int x, int y, int z);
+    // Replaces the tiles the evaluation found invalid with air, keeping the histogram and limits in step.
+    void clearInvalidTiles(Sample &sample);
+    void offerParent();
+    bool polishTile(int i);
+    bool polishSwap(int i, int j);
+    bool polishStep();
+    void addLoss(double loss);
+    void collectLosses();
   public:
-    Opt(const Settings &settings, bool useNet);
+    Opt(const Settings &settings, bool useNet, unsigned seed = std::mt19937::default_seed);
+    // Starts hill climbing from an existing design instead of a random one; an empty state means a random one.
+    // Tiles over the limits or off the symmetry are replaced, with a warning. Throws std::runtime_error on a bad state.
+    Opt(const Settings &settings, bool useNet, const xt::xtensor<int, 3> &initial, unsigned seed = std::mt19937::default_seed);
     void step();
     void stepInteractive();
+    // Steps for about the given wall-clock time, adapting the number of steps to their measured cost.
+    // Returns the number of steps taken; at least one.
+    int stepFor(double microseconds);
+    // Steps until the budget runs out; the budget needs a limit or a token. onImprovement, if set, sees each new best design.
+    RunResult run(const Common::Budget &budget, const std::function<void(const Sample &)> &onImprovement = {});
+    // Moves the surrogate's replay pool to a memory-mapped file. Returns false if there's no network or mapping failed.
+    bool setReplayFile(const std::string &path);
     bool needsRedrawBest();
     bool needsReplotLoss();
     const std::vector<double> &getLossHistory() const { return lossHistory; }
@@ -57,6 +100,20 @@ namespace Fission {
     int getNEpisode() const { return nEpisode; }
     int getNStage() const { return nStage; }
     int getNIteration() const { return nIteration; }
+    long long getNSteps() const { return nSteps; }
+    long long getNEvaluations() const { return counters.nEvaluations; }
+    // Raw fitness of the best design, comparable across runs with the same settings.
+    double getBestFitness() { return rawFitness(best.value); }
+    // Step count at the last improvement of the best design.
+    long long getLastImprovement() const { return lastImprovement; }
+    // Switches the stage and evaluation phase timings on or off; event counts are always kept.
+    void setProfiling(bool enabled);
+    // When a rollout ends on a feasible design, tries every allowed tile at each position of the fundamental domain in
+    //   turn, keeping the best feasible one, and with swaps also every exchange of tiles between positions of the same
+    //   symmetry, until a sweep finds nothing better or after maxSweeps sweeps. One position per step.
+    // Each sweep costs up to |fundamental domain| * (Air + 1) evaluations; off (0 sweeps) by default.
+    void setPolish(int maxSweeps, bool swaps);
+    Common::Counters getCounters() const;
   };
 }
 
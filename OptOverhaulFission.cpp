@@ -1,6 +1,10 @@
+#include <cmath>
+#include <stdexcept>
+#include <thread>
 #include <xtensor/xio.hpp>
 #include <xtensor/xrandom.hpp>
 #include "OverhaulFissionNet.h"
+#include "Log.h"
 
 namespace OverhaulFission {
   void Opt::restart() {
@@ -12,6 +16,8 @@ namespace OverhaulFission {
       parent.cellLimits.emplace_back(fuel.limit);
     parent.state = xt::broadcast<int>(Tiles::Air,
       {settings.sizeX, settings.sizeY, settings.sizeZ});
+    std::fill(parent.tileCounts, parent.tileCounts + Tiles::C0, 0);
+    parent.tileCounts[Tiles::Air] = settings.sizeX * settings.sizeY * settings.sizeZ;
     for (auto &[x, y, z] : allowedCoords) {
       int nSym(getNSym(x, y, z));
       allowedTiles.clear();
@@ -40,17 +46,78 @@ namespace OverhaulFission {
       setTileWithSym(parent, x, y, z, newTile);
     }
     parent.value.run(parent.state);
-    if (settings.controllable)
+    ++counters.nEvaluations;
+    if (settings.controllable) {
       parent.valueWithShield.run(parent.state);
+      ++counters.nEvaluations;
+    }
   }
 
-  Opt::Opt(Settings &settings)
-    :settings(settings),
-    nEpisode(), nStage(StageRollout), nIteration(), nConverge(),
-    penalty(xt::ones<double>({nConstraints})),
+  void Opt::restartFrom(const State &initial) {
+    auto &shape(initial.shape());
+    if (static_cast<int>(shape[0]) != settings.sizeX || static_cast<int>(shape[1]) != settings.sizeY
+      || static_cast<int>(shape[2]) != settings.sizeZ)
+      throw std::runtime_error("initial design doesn't match the reactor size");
+    int nTiles(Tiles::C0 + static_cast<int>(settings.cellTypes.size()));
+    for (int tile : initial)
+      if (tile < 0 || tile >= nTiles)
+        throw std::runtime_error("initial design has an unknown tile");
+    // Same as restart, but taking the tiles from the design while the limits allow.
+    std::copy(settings.limits, settings.limits + Tiles::Air, parent.limits);
+    std::copy(settings.sourceLimits, settings.sourceLimits + 3, parent.sourceLimits);
+    parent.cellLimits.clear();
+    for (auto &fuel : settings.fuels)
+      parent.cellLimits.emplace_back(fuel.limit);
+    parent.state = xt::broadcast<int>(Tiles::Air,
+      {settings.sizeX, settings.sizeY, settings.sizeZ});
+    std::fill(parent.tileCounts, parent.tileCounts + Tiles::C0, 0);
+    parent.tileCounts[Tiles::Air] = settings.sizeX * settings.sizeY * settings.sizeZ;
+    for (auto &[x, y, z] : allowedCoords) {
+      int tile(initial(x, y, z)), nSym(getNSym(x, y, z));
+      if (tile == Tiles::Air)
+        continue;
+      if (tile < Tiles::Air) {
+        if (parent.limits[tile] >= 0 && parent.limits[tile] < nSym)
+          continue;
+        parent.limits[tile] -= nSym;
+      } else {
+        auto &[fuel, source](settings.cellTypes[tile - Tiles::C0]);
+        if (parent.cellLimits[fuel] >= 0 && parent.cellLimits[fuel] < nSym)
+          continue;
+        if (source && parent.sourceLimits[source - 1] >= 0 && parent.sourceLimits[source - 1] < nSym)
+          continue;
+        parent.cellLimits[fuel] -= nSym;
+        if (source)
+          parent.sourceLimits[source - 1] -= nSym;
+      }
+      setTileWithSym(parent, x, y, z, tile);
+    }
+    int nChanged{};
+    auto it(initial.begin());
+    for (int tile : parent.state)
+      nChanged += tile != *it++;
+    if (nChanged)
+      Common::log(Common::LogLevel::Warn, "initial design: %d tiles changed to fit the limits and symmetry", nChanged);
+    parent.value.run(parent.state);
+    ++counters.nEvaluations;
+    if (settings.controllable) {
+      parent.valueWithShield.run(parent.state);
+      ++counters.nEvaluations;
+    }
+  }
+
+  Opt::Opt(Settings &settings, unsigned seed)
+    :Opt(settings, State(), seed) {}
+
+  Opt::Opt(Settings &settings, const State &initial, unsigned seed)
+    :rng(seed), settings(settings),
+    nEpisode(), nStage(StageRollout), nIteration(), nConverge(), nSteps(), lastImprovement(),
     hasFeasible(xt::zeros<bool>({nConstraints})),
     hasInfeasible(xt::zeros<bool>({nConstraints})),
-    bestChanged(true), redrawNagle(), lossHistory(nLossHistory), lossChanged() {
+    penalty(xt::ones<double>({nConstraints})),
+    bestChanged(true), redrawNagle(), lossHistory(nLossHistory), lossChanged(),
+    startTime(Common::Clock::now()), profiling(), nScreenCandidates(), nScreenExact(),
+    nTemperingThreads(static_cast<int>(std::thread::hardware_concurrency())) {
     settings.compute();
     for (int x(settings.symX ? settings.sizeX / 2 : 0); x < settings.sizeX; ++x)
       for (int y(settings.symY ? settings.sizeY / 2 : 0); y < settings.sizeY; ++y)
@@ -60,7 +127,10 @@ namespace OverhaulFission {
     parent.value.initialize(settings, false);
     if (settings.controllable)
       parent.valueWithShield.initialize(settings, true);
-    restart();
+    if (initial.size())
+      restartFrom(initial);
+    else
+      restart();
     net = std::make_unique<Net>(*this);
     net->appendTrajectory(net->extractFeatures(parent));
     parentFitness = currentFitness(parent);
@@ -74,6 +144,9 @@ namespace OverhaulFission {
       {settings.sizeX, settings.sizeY, settings.sizeZ});
     best.value.initialize(settings, false);
     best.value.run(best.state);
+    canonicalizeBest();
+    if (settings.nReplicas > 1)
+      startTempering();
   }
 
   xt::xtensor<bool, 1> Opt::feasible(const Sample &x) {
@@ -105,9 +178,8 @@ namespace OverhaulFission {
 
   double Opt::currentFitness(const Sample &x) {
     if (nStage == StageInfer) {
+      ++counters.nInferences;
       return net->infer(x);
-    } else if (nStage == StageTrain) {
-      return 0.0;
     } else {
       double result(rawFitness(x.value));
       result += std::min(x.value.totalRawFlux, settings.minCriticality) / static_cast<double>(settings.minCriticality);
@@ -129,34 +201,75 @@ namespace OverhaulFission {
   }
 
   void Opt::setTileWithSym(Sample &sample, int x, int y, int z, int tile) {
-    sample.state(x, y, z) = tile;
+    // Cells are not part of the histogram.
+    auto set([&](int x, int y, int z) {
+      int &slot(sample.state(x, y, z));
+      if (slot < Tiles::C0)
+        --sample.tileCounts[slot];
+      if (tile < Tiles::C0)
+        ++sample.tileCounts[tile];
+      slot = tile;
+    });
+    set(x, y, z);
     if (settings.symX) {
-      sample.state(settings.sizeX - x - 1, y, z) = tile;
+      set(settings.sizeX - x - 1, y, z);
       if (settings.symY) {
-        sample.state(x, settings.sizeY - y - 1, z) = tile;
-        sample.state(settings.sizeX - x - 1, settings.sizeY - y - 1, z) = tile;
+        set(x, settings.sizeY - y - 1, z);
+        set(settings.sizeX - x - 1, settings.sizeY - y - 1, z);
         if (settings.symZ) {
-          sample.state(x, y, settings.sizeZ - z - 1) = tile;
-          sample.state(settings.sizeX - x - 1, y, settings.sizeZ - z - 1) = tile;
-          sample.state(x, settings.sizeY - y - 1, settings.sizeZ - z - 1) = tile;
-          sample.state(settings.sizeX - x - 1, settings.sizeY - y - 1, settings.sizeZ - z - 1) = tile;
+          set(x, y, settings.sizeZ - z - 1);
+          set(settings.sizeX - x - 1, y, settings.sizeZ - z - 1);
+          set(x, settings.sizeY - y - 1, settings.sizeZ - z - 1);
+          set(settings.sizeX - x - 1, settings.sizeY - y - 1, settings.sizeZ - z - 1);
         }
       } else if (settings.symZ) {
-        sample.state(x, y, settings.sizeZ - z - 1) = tile;
-        sample.state(settings.sizeX - x - 1, y, settings.sizeZ - z - 1) = tile;
+        set(x, y, settings.sizeZ - z - 1);
+        set(settings.sizeX - x - 1, y, settings.sizeZ - z - 1);
       }
     } else if (settings.symY) {
-      sample.state(x, settings.sizeY - y - 1, z) = tile;
+      set(x, settings.sizeY - y - 1, z);
       if (settings.symZ) {
-        sample.state(x, y, settings.sizeZ - z - 1) = tile;
-        sample.state(x, settings.sizeY - y - 1, settings.sizeZ - z - 1) = tile;
+        set(x, y, settings.sizeZ - z - 1);
+        set(x, settings.sizeY - y - 1, settings.sizeZ - z - 1);
       }
     } else if (settings.symZ) {
-      sample.state(x, y, settings.sizeZ - z - 1) = tile;
+      set(x, y, settings.sizeZ - z - 1);
     }
   }
 
-  void Opt::mutateAndEvaluate(Sample &sample, int x, int y, int z) {
+  int Opt::proposeTile(const Sample &sample, int x, int y, int z, std::mt19937 &rng, std::vector<int> &allowedTiles) {
+    // Limits are read as if the current tile had already been removed.
+    int nSym(getNSym(x, y, z));
+    int oldTile(sample.state(x, y, z)), oldFuel(-1), oldSource{};
+    if (oldTile >= Tiles::C0)
+      std::tie(oldFuel, oldSource) = settings.cellTypes[oldTile - Tiles::C0];
+    allowedTiles.clear();
+    allowedTiles.emplace_back(Tiles::Air);
+    for (int tile{}; tile < Tiles::Air; ++tile) {
+      int limit(sample.limits[tile] + (tile == oldTile ? nSym : 0));
+      if (limit < 0 || limit >= nSym)
+        allowedTiles.emplace_back(tile);
+    }
+    for (int cell{}; cell < static_cast<int>(settings.cellTypes.size()); ++cell) {
+      auto &[fuel, source](settings.cellTypes[cell]);
+      int cellLimit(sample.cellLimits[fuel] + (fuel == oldFuel ? nSym : 0));
+      if (cellLimit >= 0 && cellLimit < nSym)
+        continue;
+      if (source) {
+        int sourceLimit(sample.sourceLimits[source - 1] + (source == oldSource ? nSym : 0));
+        if (sourceLimit >= 0 && sourceLimit < nSym)
+          continue;
+      }
+      allowedTiles.emplace_back(Tiles::C0 + cell);
+    }
+    return allowedTiles[std::uniform_int_distribution<>(0, static_cast<int>(allowedTiles.size() - 1))(rng)];
+  }
+
+  int Opt::proposeTile(const Sample &sample, int x, int y, int z) {
+    return proposeTile(sample, x, y, z, rng, allowedTiles);
+  }
+
+  void Opt::moveTile(Sample &sample, int x, int y, int z, int newTile) {
     int nSym(getNSym(x, y, z));
     int oldTile(sample.state(x, y, z));
     if (oldTile < Tiles::Air) {
@@ -167,20 +280,6 @@ namespace OverhaulFission {
       if (source)
         sample.sourceLimits[source - 1] += nSym;
     }
-    allowedTiles.clear();
-    allowedTiles.emplace_back(Tiles::Air);
-    for (int tile{}; tile < Tiles::Air; ++tile)
-      if (sample.limits[tile] < 0 || sample.limits[tile] >= nSym)
-        allowedTiles.emplace_back(tile);
-    for (int cell{}; cell < static_cast<int>(settings.cellTypes.size()); ++cell) {
-      auto &[fuel, source](settings.cellTypes[cell]);
-      if (sample.cellLimits[fuel] >= 0 && sample.cellLimits[fuel] < nSym)
-        continue;
-      if (source && sample.sourceLimits[source - 1] >= 0 && sample.sourceLimits[source - 1] < nSym)
-        continue;
-      allowedTiles.emplace_back(Tiles::C0 + cell);
-    }
-    int newTile(allowedTiles[std::uniform_int_distribution<>(0, static_cast<int>(allowedTiles.size() - 1))(rng)]);
     if (newTile < Tiles::Air) {
       sample.limits[newTile] -= nSym;
     } else if (newTile >= Tiles::C0) {
@@ -190,23 +289,288 @@ namespace OverhaulFission {
         sample.sourceLimits[source - 1] -= nSym;
     }
     setTileWithSym(sample, x, y, z, newTile);
+  }
+
+  // Doesn't count the evaluations, so that replicas can call it concurrently.
+  void Opt::evaluate(Sample &sample) {
     sample.value.run(sample.state);
     if (settings.controllable)
       sample.valueWithShield.run(sample.state);
   }
 
+  void Opt::applyMutation(Sample &sample, int x, int y, int z, int newTile) {
+    moveTile(sample, x, y, z, newTile);
+    evaluate(sample);
+    counters.nEvaluations += settings.controllable ? 2 : 1;
+  }
+
+  void Opt::mutateAndEvaluate(Sample &sample, int x, int y, int z) {
+    applyMutation(sample, x, y, z, proposeTile(sample, x, y, z));
+  }
+
+  void Opt::copyFrom(const Sample &source, Sample &sample) {
+    sample.state = source.state;
+    std::copy(source.limits, source.limits + Tiles::Air, sample.limits);
+    std::copy(source.sourceLimits, source.sourceLimits + 3, sample.sourceLimits);
+    sample.cellLimits = source.cellLimits;
+    std::copy(source.tileCounts, source.tileCounts + Tiles::C0, sample.tileCounts);
+  }
+
+  void Opt::canonicalizeBest() {
+    best.value.canonicalize(best.state);
+    // Canonicalizing drops tiles and neutron sources in place, so the histogram and limits are counted again.
+    std::copy(settings.limits, settings.limits + Tiles::Air, best.limits);
+    std::copy(settings.sourceLimits, settings.sourceLimits + 3, best.sourceLimits);
+    best.cellLimits.clear();
+    for (auto &fuel : settings.fuels)
+      best.cellLimits.emplace_back(fuel.limit);
+    std::fill(best.tileCounts, best.tileCounts + Tiles::C0, 0);
+    for (int tile : best.state) {
+      if (tile < Tiles::C0) {
+        ++best.tileCounts[tile];
+        if (tile < Tiles::Air && best.limits[tile] >= 0)
+          --best.limits[tile];
+      } else {
+        auto &[fuel, source](settings.cellTypes[tile - Tiles::C0]);
+        if (best.cellLimits[fuel] >= 0)
+          --best.cellLimits[fuel];
+        if (source && best.sourceLimits[source - 1] >= 0)
+          --best.sourceLimits[source - 1];
+      }
+    }
+  }
+
+  void Opt::setScreening(int nCandidates, int nExact) {
+    nScreenCandidates = nCandidates;
+    nScreenExact = std::max(1, std::min(nExact, nCandidates));
+    screenWeights.assign(Tiles::C0 + settings.cellTypes.size(), 0.0);
+    screenCandidates.resize(nScreenExact);
+    for (auto &candidate : screenCandidates) {
+      candidate.value.initialize(settings, false);
+      if (settings.controllable)
+        candidate.valueWithShield.initialize(settings, true);
+      attachProfile(candidate);
+    }
+    screenStats = ScreenStats();
+  }
+
+  bool Opt::screenAndEvaluate() {
+    std::uniform_int_distribution<>
+      xDist(0, settings.sizeX - 1),
+      yDist(0, settings.sizeY - 1),
+      zDist(0, settings.sizeZ - 1);
+    proposals.clear();
+    for (int i{}; i < nScreenCandidates; ++i) {
+      auto &proposal(proposals.emplace_back());
+      proposal.x = xDist(rng);
+      proposal.y = yDist(rng);
+      proposal.z = zDist(rng);
+      proposal.tile = proposeTile(parent, proposal.x, proposal.y, proposal.z);
+      int oldTile(parent.state(proposal.x, proposal.y, proposal.z));
+      proposal.score = (screenWeights[proposal.tile] - screenWeights[oldTile]) * getNSym(proposal.x, proposal.y, proposal.z);
+    }
+    std::partial_sort(proposals.begin(), proposals.begin() + nScreenExact, proposals.end(),
+      [](const Proposal &l, const Proposal &r) { return l.score > r.score; });
+    screenStats.nProposed += nScreenCandidates;
+    screenStats.nEvaluated += nScreenExact;
+    counters.nProposals += nScreenExact;
+    screenStats.threshold = proposals[nScreenExact - 1].score;
+
+    bool bestChangedLocal{};
+    int bestCandidate{};
+    double bestFitness{};
+    for (int i{}; i < nScreenExact; ++i) {
+      auto &proposal(proposals[i]);
+      auto &candidate(screenCandidates[i]);
+      int oldTile(parent.state(proposal.x, proposal.y, proposal.z));
+      copyFrom(parent, candidate);
+      applyMutation(candidate, proposal.x, proposal.y, proposal.z, proposal.tile);
+      double fitness(currentFitness(candidate));
+      if (fitness >= parentFitness)
+        ++screenStats.nHits;
+      // Normalized LMS on the tile-count delta: +nSym for the new tile and -nSym for the old one.
+      if (proposal.tile != oldTile) {
+        int nSym(getNSym(proposal.x, proposal.y, proposal.z));
+        double step(screenRate * (fitness - parentFitness - proposal.score) / (2 * nSym));
+        screenWeights[proposal.tile] += step;
+        screenWeights[oldTile] -= step;
+      }
+      if (xt::all(feasible(candidate)) && rawFitness(candidate.value) > rawFitness(best.value)) {
+        bestChangedLocal = true;
+        best = candidate;
+      }
+      if (!i || fitness > bestFitness) {
+        bestCandidate = i;
+        bestFitness = fitness;
+      }
+    }
+    std::swap(child, screenCandidates[bestCandidate]);
+    return bestChangedLocal;
+  }
+
+  // Relaxes the penalty of constraints that only held since the last update and tightens those that never held.
+  void Opt::updatePenalty() {
+    Common::log(Common::LogLevel::Debug, "penalty: %g %g", penalty(0), penalty(1));
+    for (int i{}; i < nConstraints; ++i) {
+      if (hasFeasible(i) && !hasInfeasible(i))
+        penalty(i) *= 0.5;
+      else if (!hasFeasible(i) && hasInfeasible(i))
+        penalty(i) = std::max(0.001, penalty(i) * 1.5);
+      hasFeasible(i) = false;
+      hasInfeasible(i) = false;
+    }
+  }
+
+  void Opt::startTempering() {
+    if (!(settings.minTemperature > 0.0) || settings.maxTemperature < settings.minTemperature)
+      throw std::runtime_error("parallel tempering needs 0 < minTemperature <= maxTemperature");
+    int nReplicas(settings.nReplicas);
+    replicas.resize(nReplicas);
+    for (int i{}; i < nReplicas; ++i) {
+      auto &replica(replicas[i]);
+      // All start from the same design; the hot ones leave it soon enough.
+      replica.sample = parent;
+      replica.trial = parent;
+      // Replicas evaluate concurrently, so they can't share the phase profile.
+      for (auto sample : { &replica.sample, &replica.trial }) {
+        sample->value.profile = nullptr;
+        sample->valueWithShield.profile = nullptr;
+      }
+      replica.fitness = parentFitness;
+      replica.temperature = settings.minTemperature
+        * std::pow(settings.maxTemperature / settings.minTemperature, static_cast<double>(i) / (nReplicas - 1));
+      replica.rng.seed(rng());
+      replica.nAccepted = 0;
+      replica.improved = false;
+    }
+    if (xt::all(feasible(parent)) && rawFitness(parent.value) > rawFitness(best.value))
+      best = parent;
+  }
+
+  void Opt::setTemperingThreads(int nThreads) {
+    nTemperingThreads = nThreads;
+    workers.reset();
+  }
+
+  // Runs on a worker thread, so it touches nothing shared but read-only state; bestFitness is the raw fitness to beat.
+  void Opt::temperReplica(Replica &replica, double bestFitness) {
+    std::uniform_int_distribution<>
+      xDist(0, settings.sizeX - 1),
+      yDist(0, settings.sizeY - 1),
+      zDist(0, settings.sizeZ - 1);
+    std::uniform_real_distribution<> uniform;
+    for (int i{}; i < temperingMoves; ++i) {
+      int x(xDist(replica.rng)), y(yDist(replica.rng)), z(zDist(replica.rng));
+      copyFrom(replica.sample, replica.trial);
+      moveTile(replica.trial, x, y, z, proposeTile(replica.trial, x, y, z, replica.rng, replica.allowedTiles));
+      evaluate(replica.trial);
+      double fitness(currentFitness(replica.trial));
+      if (xt::all(feasible(replica.trial)) && rawFitness(replica.trial.value) > bestFitness) {
+        bestFitness = rawFitness(replica.trial.value);
+        replica.best = replica.trial;
+        replica.improved = true;
+      }
+      double delta(fitness - replica.fitness);
+      if (delta >= 0.0 || uniform(replica.rng) < std::exp(delta / replica.temperature)) {
+        std::swap(replica.sample, replica.trial);
+        replica.fitness = fitness;
+        ++replica.nAccepted;
+      }
+    }
+  }
+
+  void Opt::stepTempering() {
+    double bestFitness(rawFitness(best.value));
+    if (!workers)
+      workers = std::make_unique<Common::WorkerGroup>(std::max(1, std::min(nTemperingThreads, static_cast<int>(replicas.size()))));
+    workers->run(static_cast<int>(replicas.size()), [&](int i) { temperReplica(replicas[i], bestFitness); });
+    long long nMoves(static_cast<long long>(replicas.size()) * temperingMoves);
+    counters.nProposals += nMoves;
+    counters.nEvaluations += nMoves * (settings.controllable ? 2 : 1);
+    bool bestChangedLocal{};
+    for (auto &replica : replicas) {
+      counters.nAccepted += replica.nAccepted;
+      replica.nAccepted = 0;
+      if (replica.improved) {
+        replica.improved = false;
+        if (rawFitness(replica.best.value) > rawFitness(best.value)) {
+          bestChangedLocal = true;
+          best = replica.best;
+        }
+      }
+    }
+
+    // Alternates between even and odd pairs of neighbouring temperatures.
+    std::uniform_real_distribution<> uniform;
+    for (int i(nSteps % 2); i + 1 < static_cast<int>(replicas.size()); i += 2) {
+      auto &cold(replicas[i]), &hot(replicas[i + 1]);
+      double logRatio((1.0 / cold.temperature - 1.0 / hot.temperature) * (hot.fitness - cold.fitness));
+      ++temperingStats.nSwapProposals;
+      if (logRatio >= 0.0 || uniform(rng) < std::exp(logRatio)) {
+        std::swap(cold.sample, hot.sample);
+        std::swap(cold.fitness, hot.fitness);
+        ++temperingStats.nSwaps;
+      }
+    }
+
+    // The penalty follows the coldest replica, as it follows the parent when hill climbing.
+    auto feasible(this->feasible(replicas.front().sample));
+    for (int i{}; i < nConstraints; ++i)
+      if (feasible(i))
+        hasFeasible(i) = true;
+      else
+        hasInfeasible(i) = true;
+    nIteration += temperingMoves;
+    if (nIteration >= penaltyUpdatePeriod) {
+      nIteration = 0;
+      updatePenalty();
+      for (auto &replica : replicas)
+        replica.fitness = currentFitness(replica.sample);
+    }
+
+    if (bestChangedLocal) {
+      lastImprovement = nSteps;
+      canonicalizeBest();
+      bestChanged = true;
+    }
+  }
+
+  void Opt::addLoss(double loss) {
+    for (int i{}; i < nLossHistory - 1; ++i)
+      lossHistory[i] = lossHistory[i + 1];
+    lossHistory[nLossHistory - 1] = loss;
+    lossChanged = true;
+    ++counters.nTrainIterations;
+  }
+
+  void Opt::collectLosses() {
+    trainer.drainLosses(newLosses);
+    for (double loss : newLosses)
+      addLoss(loss);
+    nIteration = trainer.poll() ? 0 : trainer.getNRemaining();
+  }
+
   void Opt::step() {
+    // The whole step is charged to the stage it started in.
+    Common::ScopedTimer timer(!profiling ? nullptr : nStage == StageTrain ? &counters.trainSeconds
+      : nStage == StageInfer ? &counters.inferSeconds : &counters.rolloutSeconds);
+    Common::TraceScope trace(nStage == StageTrain ? "train step" : nStage == StageInfer ? "infer step" : "rollout step");
+    ++nSteps;
+    if (!replicas.empty()) {
+      stepTempering();
+      return;
+    }
     if (nStage == StageTrain) {
+      if (Common::Trainer::isAsync)
+        collectLosses();
       if (!nIteration) {
         nStage = StageInfer;
+        nConverge = 0;
         restart();
         parentFitness = currentFitness(parent);
         inferenceFailed = true;
-      } else {
-        for (int i{}; i < nLossHistory - 1; ++i)
-          lossHistory[i] = lossHistory[i + 1];
-        lossHistory[nLossHistory - 1] = net->train();
-        lossChanged = true;
+      } else if (!Common::Trainer::isAsync) {
+        addLoss(net->train());
         --nIteration;
         return;
       }
@@ -214,7 +578,7 @@ namespace OverhaulFission {
       if (nConverge == maxConvergeInfer) {
         nStage = StageRollout;
         ++nEpisode;
-        std::cout << "episode " << nEpisode << std::endl;
+        Common::log(Common::LogLevel::Info, "episode %d", nEpisode);
         if (inferenceFailed)
           restart();
         net->newTrajectory();
@@ -230,6 +594,9 @@ namespace OverhaulFission {
       net->finishTrajectory(localBest);
       nConverge = 0;
       nIteration = (net->getTrajectoryLength() * nEpoch + nMiniBatch - 1) / nMiniBatch;
+      // While the network trains in the background, the search keeps climbing on the exact fitness.
+      if (Common::Trainer::isAsync)
+        trainer.start(nIteration, [this] { return net->train(); });
       return;
     }
 
@@ -240,11 +607,14 @@ namespace OverhaulFission {
       xDist(0, settings.sizeX - 1),
       yDist(0, settings.sizeY - 1),
       zDist(0, settings.sizeZ - 1);
-    child.state = parent.state;
-    std::copy(parent.limits, parent.limits + Tiles::Air, child.limits);
-    std::copy(parent.sourceLimits, parent.sourceLimits + 3, child.sourceLimits);
-    child.cellLimits = parent.cellLimits;
-    mutateAndEvaluate(child, xDist(rng), yDist(rng), zDist(rng));
+    if (nStage == StageRollout && nScreenCandidates > 1) {
+      if (screenAndEvaluate())
+        bestChangedLocal = true;
+    } else {
+      copyFrom(parent, child);
+      mutateAndEvaluate(child, xDist(rng), yDist(rng), zDist(rng));
+      ++counters.nProposals;
+    }
     double childFitness(currentFitness(child));
     if (xt::all(feasible(child)) && rawFitness(child.value) > rawFitness(best.value)) {
       bestChangedLocal = true;
@@ -258,20 +628,21 @@ namespace OverhaulFission {
           inferenceFailed = false;
         }
       }
-      if (nStage != StageInfer && !std::uniform_int_distribution<>(0, 9)(rng))
--        trajectoryBuffer.emplace_back(net->extractFeatures(child));
+      if (nStage == StageRollout && !std::uniform_int_distribution<>(0, 9)(rng))
+        trajectoryBuffer.emplace_back(net->extractFeatures(child));
       std::swap(parent, child);
+      ++counters.nAccepted;
     }
 
-    if (nStage != StageInfer) {
+    if (nStage == StageRollout) {
       auto feasible(this->feasible(parent));
       if (xt::all(feasible)) {
         if (parentFitness > localBest) {
           localBest = parentFitness;
-          std::cout << "localBest: " << localBest << std::endl;
+          Common::log(Common::LogLevel::Debug, "localBest: %g", localBest);
           nConverge = 0;
           while (!trajectoryBuffer.empty()) {
-            net->appendTrajectory(std::move(trajectoryBuffer.back()));
+            net->appendTrajectory(trajectoryBuffer.back());
             trajectoryBuffer.pop_back();
           }
         }
@@ -281,24 +652,17 @@ namespace OverhaulFission {
           hasFeasible(i) = true;
         else
           hasInfeasible(i) = true;
-      if (!(nIteration % penaltyUpdatePeriod)) {
-        std::cout << penalty(0) << std::endl;
-        for (int i{}; i < nConstraints; ++i) {
-          if (hasFeasible(i) && !hasInfeasible(i))
-            penalty(i) *= 0.5;
-          else if (!hasFeasible(i) && hasInfeasible(i))
-            penalty(i) = std::max(0.001, penalty(i) * 1.5);
-          hasFeasible(i) = false;
-          hasInfeasible(i) = false;
-        }
-      }
+      if (!(nIteration % penaltyUpdatePeriod))
+        updatePenalty();
       parentFitness = currentFitness(parent);
     }
 
     ++nConverge;
-    ++nIteration;
+    if (nStage != StageTrain)
+      ++nIteration;
     if (bestChangedLocal) {
-      best.value.canonicalize(best.state);
+      lastImprovement = nSteps;
+      canonicalizeBest();
       bestChanged = true;
     }
   }
@@ -306,12 +670,70 @@ namespace OverhaulFission {
   void Opt::stepInteractive() {
     int dim(settings.sizeX * settings.sizeY * settings.sizeZ);
     int n(std::min(interactiveMin, (interactiveScale + dim - 1) / dim));
-    for (int i{}; i < (nStage == StageTrain ? interactiveNet : nStage == StageInfer ? interactiveNet * nMiniBatch : n); ++i) {
+    // A tempering step makes temperingMoves moves on each replica.
+    if (!replicas.empty())
+      n = std::max(1, n / temperingMoves);
+    bool isTraining(nStage == StageTrain && !Common::Trainer::isAsync);
+    for (int i{}; i < (isTraining ? interactiveNet : nStage == StageInfer ? interactiveNet * nMiniBatch : n); ++i) {
       step();
       ++redrawNagle;
     }
   }
 
+  int Opt::stepFor(double microseconds) {
+    return pacer.run(microseconds * 1e-6, [this] {
+      step();
+      ++redrawNagle;
+    }, [this] { return nStage; });
+  }
+
+  RunResult Opt::run(const Common::Budget &budget, const std::function<void(const Sample &)> &onImprovement) {
+    Common::BudgetTracker tracker(budget, nSteps, counters.nEvaluations, lastImprovement);
+    long long reported(lastImprovement);
+    Common::StopReason stopReason;
+    while (!tracker.check(nSteps, counters.nEvaluations, lastImprovement, rawFitness(best.value), stopReason)) {
+      step();
+      if (onImprovement && lastImprovement != reported) {
+        reported = lastImprovement;
+        onImprovement(best);
+      }
+    }
+    return {stopReason, best};
+  }
+
+  bool Opt::setReplayFile(const std::string &path) {
+    // The pool can't move under a running training thread.
+    if (!net || nStage == StageTrain)
+      return false;
+    return net->openReplayFile(path);
+  }
+
+  void Opt::attachProfile(Sample &sample) {
+    Common::PhaseProfile *profile(profiling ? &counters.phases : nullptr);
+    sample.value.profile = profile;
+    sample.valueWithShield.profile = profile;
+  }
+
+  void Opt::setProfiling(bool enabled) {
+    profiling = enabled;
+    attachProfile(parent);
+    attachProfile(child);
+    attachProfile(best);
+    for (auto &candidate : screenCandidates)
+      attachProfile(candidate);
+  }
+
+  Common::Counters Opt::getCounters() const {
+    Common::Counters result(counters);
+    result.seconds = std::chrono::duration<double>(Common::Clock::now() - startTime).count();
+    result.nSteps = nSteps;
+    auto &pool(net->getPool());
+    result.poolSize = pool.getSize();
+    result.nPoolAppends = pool.getNAppends();
+    result.nPoolDuplicates = pool.getNDuplicates();
+    return result;
+  }
+
   bool Opt::needsRedrawBest() {
     bool result(bestChanged && redrawNagle >= interactiveMin);
     if (result) {
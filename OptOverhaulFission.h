@@ -1,6 +1,12 @@
 #ifndef _OPT_OVERHAUL_FISSION_H_
 #define _OPT_OVERHAUL_FISSION_H_
 #include <random>
+#include <functional>
+#include <memory>
+#include "Budget.h"
+#include "Pacer.h"
+#include "Trainer.h"
+#include "Workers.h"
 #include "OverhaulFission.h"
 
 namespace OverhaulFission {
@@ -8,6 +14,8 @@ namespace OverhaulFission {
     int limits[Tiles::Air];
     int sourceLimits[3];
     std::vector<int> cellLimits;
+    // Histogram of the non-cell tiles in state, kept up to date by Opt::setTileWithSym and Opt::canonicalizeBest.
+    int tileCounts[Tiles::C0];
     xt::xtensor<int, 3> state;
     Evaluation value, valueWithShield;
   };
@@ -21,6 +29,26 @@ namespace OverhaulFission {
   constexpr int interactiveMin(4096), interactiveScale(327680), interactiveNet(4), nLossHistory(256);
   constexpr int maxConvergeInfer(10976), maxConvergeRollout(maxConvergeInfer * 100), nConstraints(2), penaltyUpdatePeriod(maxConvergeInfer);
 
+  constexpr double screenRate(0.1);
+  // Metropolis moves per replica between swaps.
+  constexpr int temperingMoves(16);
+
+  struct ScreenStats {
+    long long nProposed{}, nEvaluated{}, nHits{};
+    // Predicted fitness delta of the last proposal that still got an exact evaluation.
+    double threshold{};
+  };
+
+  struct TemperingStats {
+    // Swaps between neighbouring temperatures proposed and accepted.
+    long long nSwapProposals{}, nSwaps{};
+  };
+
+  struct RunResult {
+    Common::StopReason stopReason;
+    Sample best;
+  };
+
   class Net;
 
   class Opt {
@@ -31,6 +59,7 @@ namespace OverhaulFission {
     std::vector<int> allowedTiles;
     int nEpisode, nStage, nIteration;
     int nConverge;
+    long long nSteps, lastImprovement;
     xt::xtensor<bool, 1> hasFeasible, hasInfeasible;
     xt::xtensor<double, 1> penalty;
     std::vector<xt::xtensor<double, 1>> trajectoryBuffer;
@@ -40,27 +69,99 @@ namespace OverhaulFission {
     bool inferenceFailed;
     bool bestChanged;
     int redrawNagle;
-    std::vector<double> lossHistory;
+    std::vector<double> lossHistory, newLosses;
     bool lossChanged;
+    Common::Counters counters;
+    Common::Clock::time_point startTime;
+    bool profiling;
+    // Slots are rollout, train and infer.
+    Common::Pacer<3> pacer;
+    struct Proposal {
+      int x, y, z, tile;
+      double score;
+    };
+    int nScreenCandidates, nScreenExact;
+    std::vector<double> screenWeights;
+    std::vector<Proposal> proposals;
+    std::vector<Sample> screenCandidates;
+    ScreenStats screenStats;
+    // Parallel tempering, coldest first. Replicas keep their temperatures and swap designs.
+    struct Replica {
+      Sample sample, trial, best;
+      double fitness, temperature;
+      std::mt19937 rng;
+      std::vector<int> allowedTiles;
+      long long nAccepted;
+      bool improved;
+    };
+    std::vector<Replica> replicas;
+    // Started on the first tempering step, so that setTemperingThreads can size it first.
+    std::unique_ptr<Common::WorkerGroup> workers;
+    int nTemperingThreads;
+    TemperingStats temperingStats;
+    // Declared after net so that a running training thread is joined before the network is destroyed.
+    Common::Trainer trainer;
     void restart();
+    void restartFrom(const State &initial);
     xt::xtensor<bool, 1> feasible(const Sample &x);
     xt::xtensor<double, 1> infeasibility(const Sample &x);
     double rawFitness(const Evaluation &x);
     double currentFitness(const Sample &x);
     int getNSym(int x, int y, int z);
     void setTileWithSym(Sample &sample, int x, int y, int z, int tile);
+    int proposeTile(const Sample &sample, int x, int y, int z, std::mt19937 &rng, std::vector<int> &allowedTiles);
+    int proposeTile(const Sample &sample, int x, int y, int z);
+    void moveTile(Sample &sample, int x, int y, int z, int newTile);
+    void evaluate(Sample &sample);
+    void applyMutation(Sample &sample, int x, int y, int z, int newTile);
     void mutateAndEvaluate(Sample &sample, int x, int y, int z);
+    void copyFrom(const Sample &source, Sample &sample);
+    void attachProfile(Sample &sample);
+    void canonicalizeBest();
+    bool screenAndEvaluate();
+    void updatePenalty();
+    void startTempering();
+    void temperReplica(Replica &replica, double bestFitness);
+    void stepTempering();
+    void addLoss(double loss);
+    void collectLosses();
   public:
-    Opt(Settings &settings);
+    Opt(Settings &settings, unsigned seed = std::mt19937::default_seed);
+    // Starts hill climbing from an existing design instead of a random one; an empty state means a random one.
+    // Tiles over the limits or off the symmetry are replaced, with a warning. Throws std::runtime_error on a bad state.
+    Opt(Settings &settings, const State &initial, unsigned seed = std::mt19937::default_seed);
     void step();
     void stepInteractive();
+    // Steps for about the given wall-clock time, adapting the number of steps to their measured cost.
+    // Returns the number of steps taken; at least one.
+    int stepFor(double microseconds);
+    // Steps until the budget runs out; the budget needs a limit or a token. onImprovement, if set, sees each new best design.
+    RunResult run(const Common::Budget &budget, const std::function<void(const Sample &)> &onImprovement = {});
+    // Moves the surrogate's replay pool to a memory-mapped file. Returns false if there's no network or mapping failed.
+    bool setReplayFile(const std::string &path);
     bool needsRedrawBest();
     bool needsReplotLoss();
+    // Screens nCandidates random mutations per rollout step with a linear model and evaluates only the best nExact of them.
+    // Parallel tempering doesn't screen.
+    void setScreening(int nCandidates, int nExact);
+    const ScreenStats &getScreenStats() const { return screenStats; }
+    // Spreads the replicas of parallel tempering over nThreads threads, counting the caller; the default is one per core.
+    void setTemperingThreads(int nThreads);
+    const TemperingStats &getTemperingStats() const { return temperingStats; }
     const std::vector<double> &getLossHistory() const { return lossHistory; }
     const Sample &getBest() const { return best; }
     int getNEpisode() const { return nEpisode; }
     int getNStage() const { return nStage; }
     int getNIteration() const { return nIteration; }
+    long long getNSteps() const { return nSteps; }
+    long long getNEvaluations() const { return counters.nEvaluations; }
+    // Raw fitness of the best design, comparable across runs with the same settings.
+    double getBestFitness() { return rawFitness(best.value); }
+    // Step count at the last improvement of the best design.
+    long long getLastImprovement() const { return lastImprovement; }
+    // Switches the stage and evaluation phase timings on or off; event counts are always kept.
+    void setProfiling(bool enabled);
+    Common::Counters getCounters() const;
   };
 }
 
@@ -1,3 +1,4 @@
+#include "Hash.h"
 #include "OverhaulFission.h"
 
 namespace OverhaulFission {
@@ -28,8 +29,33 @@ namespace OverhaulFission {
     }
   }
 
+  std::uint64_t Settings::hash() const {
+    // Only the inputs; the computed fields follow from them.
+    Common::Hasher hasher;
+    hasher.add(sizeX);
+    hasher.add(sizeY);
+    hasher.add(sizeZ);
+    hasher.add(fuels.size());
+    for (auto &fuel : fuels) {
+      hasher.add(fuel.efficiency);
+      hasher.add(fuel.limit);
+      hasher.add(fuel.criticality);
+      hasher.add(fuel.heat);
+      hasher.add(fuel.selfPriming);
+    }
+    hasher.add(limits);
+    hasher.add(sourceLimits);
+    hasher.add(goal);
+    hasher.add(controllable);
+    hasher.add(symX);
+    hasher.add(symY);
+    hasher.add(symZ);
+    return hasher.get();
+  }
+
   void Evaluation::initialize(const Settings &settings, bool shieldOn) {
     tiles = xt::empty<Tile>({settings.sizeX, settings.sizeY, settings.sizeZ});
+    nFunctionalTiles.assign(Tiles::Air, 0);
     this->settings = &settings;
     this->shieldOn = shieldOn;
   }
@@ -484,16 +510,33 @@ namespace OverhaulFission {
 
   void Evaluation::computeSparsity() {
     nFunctionalBlocks = 0;
+    std::fill(nFunctionalTiles.begin(), nFunctionalTiles.end(), 0);
     for (int x{}; x < settings->sizeX; ++x) {
       for (int y{}; y < settings->sizeY; ++y) {
         for (int z{}; z < settings->sizeZ; ++z) {
           std::visit(Overload {
             [&](Cell &tile) { nFunctionalBlocks += tile.isActive; },
-            [&](Moderator &tile) { nFunctionalBlocks += tile.isFunctional; },
-            [&](Reflector &tile) { nFunctionalBlocks += tile.isActive; },
-            [&](Shield &tile) { nFunctionalBlocks += !!tile.flux; },
-            [&](Irradiator &tile) { nFunctionalBlocks += !!tile.flux; },
-            [&](HeatSink &tile) { nFunctionalBlocks += tile.isActive; },
+            [&](Moderator &tile) {
+              nFunctionalBlocks += tile.isFunctional;
+              nFunctionalTiles[Tiles::M0 + tile.type] += tile.isFunctional;
+            },
+            [&](Reflector &tile) {
+              nFunctionalBlocks += tile.isActive;
+              nFunctionalTiles[Tiles::R0 + tile.type] += tile.isActive;
+            },
+            [&](Shield &tile) {
+              nFunctionalBlocks += !!tile.flux;
+              nFunctionalTiles[Tiles::Shield] += !!tile.flux;
+            },
+            [&](Irradiator &tile) {
+              nFunctionalBlocks += !!tile.flux;
+              nFunctionalTiles[Tiles::Irradiator] += !!tile.flux;
+            },
+            [&](HeatSink &tile) {
+              nFunctionalBlocks += tile.isActive;
+              nFunctionalTiles[tile.type] += tile.isActive;
+            },
+            [&](Conductor &tile) { nFunctionalTiles[Tiles::Conductor] += tile.cluster >= 0; },
             [](...) {}
           }, tiles(x, y, z));
         }
@@ -532,6 +575,8 @@ namespace OverhaulFission {
   }
 
   void Evaluation::run(const State &state) {
+    Common::TraceScope trace("evaluate");
+    Common::PhaseTimer timer(profile);
     cells.clear();
     tier1s.clear();
     tier2s.clear();
@@ -603,6 +648,7 @@ namespace OverhaulFission {
         }
       }
     }
+    timer.next(Common::PhaseFlux);
     totalRawFlux = 0;
     for (auto &[x, y, z] : cells) {
       checkNeutronSource(x, y, z);
@@ -610,12 +656,14 @@ namespace OverhaulFission {
     }
     propagateFlux();
     computeFluxActivation();
+    timer.next(Common::PhaseHeatSinks);
     for (auto &[x, y, z] : tier1s)
       computeHeatSinkActivation(x, y, z);
     for (auto &[x, y, z] : tier2s)
       computeHeatSinkActivation(x, y, z);
     for (auto &[x, y, z] : tier3s)
       computeHeatSinkActivation(x, y, z);
+    timer.next(Common::PhaseClusters);
     clusters.clear();
     for (auto &[x, y, z] : cells)
       propagateCluster(-1, x, y, z);
@@ -626,7 +674,9 @@ namespace OverhaulFission {
       propagateCluster(-1, x, y, z);
     for (auto &i : clusters)
       computeClusterStats(i);
+    timer.next(Common::PhaseSparsity);
     computeSparsity();
+    timer.next(Common::PhaseStats);
     computeStats();
   }
 
@@ -1,9 +1,11 @@
 #ifndef _OVERHAUL_FISSION_H_
 #define _OVERHAUL_FISSION_H_
 #include <xtensor/xtensor.hpp>
+#include <cstdint>
 #include <optional>
 #include <variant>
 #include <vector>
+#include "Counters.h"
 
 namespace OverhaulFission {
   constexpr double moderatorEfficiencies[] { 1.1, 1.05, 1.0 };
@@ -57,6 +59,10 @@ namespace OverhaulFission {
     int goal;
     bool controllable;
     bool symX, symY, symZ;
+    // Search engine, not part of the hash: with two or more replicas, Opt runs parallel tempering between these
+    //   temperatures instead of hill climbing with the surrogate.
+    int nReplicas{1};
+    double minTemperature{0.0003}, maxTemperature{0.03};
     // Computed
     std::vector<std::pair<int, int>> cellTypes;
     double maxOutput;
@@ -64,6 +70,8 @@ namespace OverhaulFission {
     int minHeat;
     
     void compute();
+    // Stable across runs, for matching results and replay files to the settings that produced them.
+    std::uint64_t hash() const;
   };
 
   using State = xt::xtensor<int, 3>;
@@ -144,7 +152,11 @@ namespace OverhaulFission {
     xt::xtensor<Tile, 3> tiles;
     std::vector<Coord> cells, tier1s, tier2s, tier3s, shields, irradiators, conductors, fluxRoots;
     std::vector<Cluster> clusters;
+    // Number of functional tiles of each non-cell type; conductors count when they belong to a cluster.
+    std::vector<int> nFunctionalTiles;
     const Settings *settings;
+    // Phase timings go here while set.
+    Common::PhaseProfile *profile{};
     double rawEfficiency, efficiency, rawOutput, output, density, sparsityPenalty;
     int nFunctionalBlocks, totalPositiveNetHeat, irradiatorFlux, nActiveCells, totalRawFlux, maxCellFlux;
     bool shieldOn;
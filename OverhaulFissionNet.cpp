@@ -1,15 +1,21 @@
 #include <xtensor/xrandom.hpp>
 #include "OverhaulFissionNet.h"
+#include "Log.h"
 
 namespace OverhaulFission {
-  Net::Net(Opt &opt) :opt(opt), mCorrector(1), rCorrector(1), trajectoryLength(), writePos() {
+  Net::Net(Opt &opt) :opt(opt), rng(opt.rng()), mCorrector(1), rCorrector(1), nTileTypes(), isPrepared(), useQuantized(), quantizationError() {
+    tileMap.assign(Tiles::Air + 1, -1);
     for (int i{}; i < Tiles::Air; ++i)
       if (opt.settings.limits[i])
-        tileMap.emplace(i, tileMap.size());
-    tileMap.emplace(Tiles::Air, tileMap.size());
-    nFeatures = static_cast<int>(tileMap.size()) * 2 - 1 + nStatisticalFeatures;
+        tileMap[i] = nTileTypes++;
+    tileMap[Tiles::Air] = nTileTypes++;
+    nFeatures = nTileTypes * 2 - 1 + nStatisticalFeatures;
     batchInput = xt::empty<double>({nMiniBatch, nFeatures});
     batchTarget = xt::empty<double>({nMiniBatch});
+    batchWeight = xt::ones<double>({nMiniBatch});
+    batchRows.resize(nMiniBatch);
+    wLayer1T = xt::empty<double>({nFeatures, nLayer1});
+    pool.initialize(nFeatures, nPool, prioritizedReplay, deduplicatedReplay);
 
     wLayer1 = xt::random::randn({nLayer1, nFeatures}, 0.0, 1.0 / std::sqrt(nFeatures), opt.rng);
     mwLayer1 = xt::zeros_like(wLayer1);
@@ -33,53 +39,24 @@ namespace OverhaulFission {
     rbOutput = 0.0;
   }
 
-  void Net::appendTrajectory(xt::xtensor<double, 1> features) {
-    if (trajectoryLength < nPool)
-      ++trajectoryLength;
-    if (pool.size() == nPool)
-      pool[writePos].first = std::move(features);
-    else
-      pool.emplace_back(std::move(features), 0.0);
-    if (++writePos == nPool)
-      writePos = 0;
+  void Net::appendTrajectory(const xt::xtensor<double, 1> &features) {
+    pool.append(features.data());
   }
 
   void Net::finishTrajectory(double target) {
-    int pos(writePos);
-    for (int i{}; i < trajectoryLength; ++i) {
-      if (--pos < 0)
-        pos = nPool - 1;
-      pool[pos].second = target;
-    }
-    std::cout << "trajectoryLength: " << trajectoryLength << std::endl;
-    std::cout << "pool: " << pool.size() << std::endl;
+    pool.finishTrajectory(target);
+    Common::log(Common::LogLevel::Info, "trajectoryLength: %d, pool: %d", pool.getTrajectoryLength(), pool.getSize());
   }
 
   xt::xtensor<double, 1> Net::extractFeatures(const Sample &sample) {
     xt::xtensor<double, 1> vInput(xt::zeros<double>({nFeatures}));
-    for (int x{}; x < opt.settings.sizeX; ++x) {
-      for (int y{}; y < opt.settings.sizeY; ++y) {
-        for (int z{}; z < opt.settings.sizeZ; ++z) {
-          int tile(sample.state(x, y, z));
-          if (tile > Tiles::Air)
-            continue;
-          int index(tileMap[tile]);
-          ++vInput[index];
-          if (tile == Tiles::Air)
-            continue;
-          bool isFunctional;
-          std::visit(Overload {
-            [&](const Moderator &tile) { isFunctional = tile.isFunctional; },
-            [&](const Reflector &tile) { isFunctional = tile.isActive; },
-            [&](const Shield &tile) { isFunctional = tile.flux; },
-            [&](const Irradiator &tile) { isFunctional = tile.flux; },
-            [&](const HeatSink &tile) { isFunctional = tile.isActive; },
-            [&](const Conductor &tile) { isFunctional = tile.cluster >= 0; },
-            [] (...) { throw; }
-          }, sample.value.tiles(x, y, z));
-          vInput[tileMap.size() + index] += isFunctional;
-        }
-      }
+    for (int tile{}; tile <= Tiles::Air; ++tile) {
+      int index(tileMap[tile]);
+      if (index < 0)
+        continue;
+      vInput[index] = sample.tileCounts[tile];
+      if (tile != Tiles::Air)
+        vInput[nTileTypes + index] = sample.value.nFunctionalTiles[tile];
     }
     vInput.periodic(-8) = sample.value.cells.size();
     vInput.periodic(-7) = sample.value.nActiveCells;
@@ -94,55 +71,152 @@ namespace OverhaulFission {
   }
 
   double Net::infer(const Sample &sample) {
-    auto vInput(extractFeatures(sample));
-    xt::xtensor<double, 1> vLayer1(bLayer1 + xt::sum(wLayer1 * vInput, -1));
-    xt::xtensor<double, 1> vPwlLayer1(vLayer1 * leak + xt::clip(vLayer1, -1.0, 1.0));
-    xt::xtensor<double, 1> vLayer2(bLayer2 + xt::sum(wLayer2 * vPwlLayer1, -1));
-    xt::xtensor<double, 1> vPwlLayer2(vLayer2 * leak + xt::clip(vLayer2, -1.0, 1.0));
-    return bOutput + xt::sum(wOutput * vPwlLayer2)();
+    return inferBatch(&sample, 1)(0);
+  }
+
+  void Net::appendSparse(const Sample &sample) {
+    // Emits the non-zero entries of extractFeatures in index order without building the dense vector.
+    auto push([&](int index, double value) {
+      if (value != 0.0)
+        sparseInput.push(index, value);
+    });
+    double volume(opt.settings.sizeX * opt.settings.sizeY * opt.settings.sizeZ);
+    for (int tile{}; tile <= Tiles::Air; ++tile)
+      if (tileMap[tile] >= 0)
+        push(tileMap[tile], sample.tileCounts[tile] / volume);
+    for (int tile{}; tile < Tiles::Air; ++tile)
+      if (tileMap[tile] >= 0)
+        push(nTileTypes + tileMap[tile], sample.value.nFunctionalTiles[tile] / volume);
+    push(nFeatures - 8, sample.value.cells.size() / volume);
+    push(nFeatures - 7, sample.value.nActiveCells / volume);
+    push(nFeatures - 6, sample.value.clusters.size() / volume);
+    push(nFeatures - 5, static_cast<double>(sample.value.totalRawFlux) / opt.settings.minCriticality);
+    push(nFeatures - 4, static_cast<double>(sample.value.totalPositiveNetHeat) / opt.settings.minHeat);
+    push(nFeatures - 3, sample.value.output / opt.settings.maxOutput);
+    push(nFeatures - 2, sample.value.efficiency);
+    push(nFeatures - 1, static_cast<double>(sample.value.irradiatorFlux) / opt.settings.minCriticality);
+    sparseInput.finishRow();
+  }
+
+  xt::xtensor<double, 1> Net::inferBatch(const Sample *samples, int n) {
+    Common::TraceScope trace("inferBatch");
+    if (!isPrepared)
+      prepareInference();
+    // Most tile types are absent from any one design, so layer 1 only accumulates the non-zero features.
+    sparseInput.clear();
+    for (int i{}; i < n; ++i)
+      appendSparse(samples[i]);
+    if (!useQuantized)
+      return forward(sparseInput);
+    xt::xtensor<double, 1> vOutput(xt::empty<double>({n}));
+    for (int i{}; i < n; ++i) {
+      int offset(sparseInput.offsets[i]);
+      vOutput(i) = quantized.infer(sparseInput.offsets[i + 1] - offset,
+        sparseInput.indices.data() + offset, sparseInput.values.data() + offset);
+    }
+    return vOutput;
+  }
+
+  xt::xtensor<double, 1> Net::forward(const Common::SparseRows &input) {
+    // Activations are stored with one column per sample so that every product streams through the weights once.
+    int n(input.getNRows());
+    xt::xtensor<double, 2> vLayer1(xt::broadcast(xt::view(bLayer1, xt::all(), xt::newaxis()), {nLayer1, n}));
+    Common::spmm(nLayer1, wLayer1T.data(), input, vLayer1.data());
+    xt::xtensor<double, 2> vPwlLayer1(vLayer1 * leak + xt::clip(vLayer1, -1.0, 1.0));
+    xt::xtensor<double, 2> vLayer2(xt::broadcast(xt::view(bLayer2, xt::all(), xt::newaxis()), {nLayer2, n}));
+    Common::gemmNN(nLayer2, n, nLayer1, wLayer2.data(), vPwlLayer1.data(), vLayer2.data());
+    xt::xtensor<double, 2> vPwlLayer2(vLayer2 * leak + xt::clip(vLayer2, -1.0, 1.0));
+    xt::xtensor<double, 1> vOutput(xt::empty<double>({n}));
+    vOutput.fill(bOutput);
+    Common::gemmNN(1, n, nLayer2, wOutput.data(), vPwlLayer2.data(), vOutput.data());
+    return vOutput;
+  }
+
+  void Net::prepareInference() {
+    isPrepared = true;
+    for (int i{}; i < nLayer1; ++i)
+      for (int j{}; j < nFeatures; ++j)
+        wLayer1T(j, i) = wLayer1(i, j);
+    quantized.quantize(nFeatures, nLayer1, nLayer2, wLayer1.data(), bLayer1.data(),
+      wLayer2.data(), bLayer2.data(), wOutput.data(), bOutput, leak);
+    // Validate against the float path on pool rows; fall back to floats if the fixed-point ranges don't fit this network.
+    int n(std::min(nQuantizationCheck, pool.getSize()));
+    if (!n) {
+      quantizationError = 0.0;
+      useQuantized = false;
+      return;
+    }
+    std::uniform_int_distribution<> dist(0, pool.getSize() - 1);
+    Common::SparseRows rows;
+    for (int i{}; i < n; ++i) {
+      const float *input(pool.getInput(dist(rng)));
+      for (int j{}; j < nFeatures; ++j)
+        if (input[j] != 0.0f)
+          rows.push(j, input[j]);
+      rows.finishRow();
+    }
+    xt::xtensor<double, 1> vQuantized(xt::empty<double>({n}));
+    for (int i{}; i < n; ++i) {
+      int offset(rows.offsets[i]);
+      vQuantized(i) = quantized.infer(rows.offsets[i + 1] - offset, rows.indices.data() + offset, rows.values.data() + offset);
+    }
+    xt::xtensor<double, 1> vOutput(forward(rows));
+    double scale(std::max(1.0, xt::amax(xt::abs(vOutput))()));
+    quantizationError = xt::amax(xt::abs(vQuantized - vOutput))() / scale;
+    useQuantized = quantizationError <= quantizationTolerance;
   }
 
   double Net::train() {
+    Common::TraceScope trace("train");
     // Assemble batch
-    std::uniform_int_distribution<size_t> dist(0, pool.size() - 1);
     for (int i{}; i < nMiniBatch; ++i) {
-      auto &sample(pool[dist(opt.rng)]);
-      xt::view(batchInput, i, xt::all()) = sample.first;
-      batchTarget(i) = sample.second;
+      int row(pool.sample(rng));
+      batchRows[i] = row;
+      const float *input(pool.getInput(row));
+      std::copy(input, input + nFeatures, batchInput.data() + i * nFeatures);
+      batchTarget(i) = pool.getTarget(row);
+      if (prioritizedReplay)
+        batchWeight(i) = std::pow(pool.getSize() * pool.getProbability(row), -replayBeta);
     }
+    if (prioritizedReplay)
+      batchWeight /= xt::amax(batchWeight)();
 
     // Forward
-    xt::xtensor<double, 2> vLayer1(bLayer1 + xt::sum(wLayer1 * xt::view(batchInput, xt::all(), xt::newaxis(), xt::all()), -1));
+    xt::xtensor<double, 2> vLayer1(xt::broadcast(bLayer1, {nMiniBatch, nLayer1}));
+    Common::gemmNT(nMiniBatch, nLayer1, nFeatures, batchInput.data(), wLayer1.data(), vLayer1.data());
     xt::xtensor<double, 2> vPwlLayer1(vLayer1 * leak + xt::clip(vLayer1, -1.0, 1.0));
-    xt::xtensor<double, 2> vLayer2(bLayer2 + xt::sum(wLayer2 * xt::view(vPwlLayer1, xt::all(), xt::newaxis(), xt::all()), -1));
+    xt::xtensor<double, 2> vLayer2(xt::broadcast(bLayer2, {nMiniBatch, nLayer2}));
+    Common::gemmNT(nMiniBatch, nLayer2, nLayer1, vPwlLayer1.data(), wLayer2.data(), vLayer2.data());
     xt::xtensor<double, 2> vPwlLayer2(vLayer2 * leak + xt::clip(vLayer2, -1.0, 1.0));
-    xt::xtensor<double, 1> vOutput(bOutput + xt::sum(wOutput * vPwlLayer2, -1));
+    xt::xtensor<double, 1> vOutput(xt::empty<double>({nMiniBatch}));
+    vOutput.fill(bOutput);
+    Common::gemv(nMiniBatch, nLayer2, vPwlLayer2.data(), wOutput.data(), vOutput.data());
     xt::xtensor<double, 1> losses(xt::square(vOutput - batchTarget));
     double loss(xt::mean(losses)());
+    if (prioritizedReplay)
+      for (int i{}; i < nMiniBatch; ++i)
+        pool.updatePriority(batchRows[i], std::pow(std::sqrt(losses(i)) + 1e-6, replayAlpha));
 
     // Backward
-    xt::xtensor<double, 1> gvOutput((vOutput - batchTarget) * 2 / nMiniBatch);
+    xt::xtensor<double, 1> gvOutput((vOutput - batchTarget) * batchWeight * 2 / nMiniBatch);
     double gbOutput(xt::sum(gvOutput)());
-    xt::xtensor<double, 1> gwOutput(xt::sum(xt::view(gvOutput, xt::all(), xt::newaxis()) * vPwlLayer2, 0));
-    xt::xtensor<double, 2> gvPwlLayer2(xt::empty_like(vPwlLayer2));
-    for (int i{}; i < nMiniBatch; ++i)
-      for (int j{}; j < nLayer2; ++j)
-        gvPwlLayer2(i, j) = gvOutput(i) * wOutput(j);
+    xt::xtensor<double, 1> gwOutput(xt::zeros_like(wOutput));
+    Common::gemmTN(nLayer2, 1, nMiniBatch, vPwlLayer2.data(), gvOutput.data(), gwOutput.data());
+    xt::xtensor<double, 2> gvPwlLayer2(xt::zeros_like(vPwlLayer2));
+    Common::gemmNN(nMiniBatch, nLayer2, 1, gvOutput.data(), wOutput.data(), gvPwlLayer2.data());
     xt::xtensor<double, 2> gvLayer2(gvPwlLayer2 * (leak + (xt::abs(vLayer2) < 1.0)));
     xt::xtensor<double, 1> gbLayer2(xt::sum(gvLayer2, 0));
-    xt::xtensor<double, 2> gwLayer2(xt::empty_like(wLayer2));
-    for (int i{}; i < nLayer2; ++i)
-      for (int j{}; j < nLayer1; ++j)
-        gwLayer2(i, j) = xt::sum(xt::view(gvLayer2, xt::all(), i) * xt::view(vPwlLayer1, xt::all(), j))();
-    xt::xtensor<double, 2> gvPwlLayer1(xt::sum(xt::view(gvLayer2, xt::all(), xt::all(), xt::newaxis()) * wLayer2, -2));
+    xt::xtensor<double, 2> gwLayer2(xt::zeros_like(wLayer2));
+    Common::gemmTN(nLayer2, nLayer1, nMiniBatch, gvLayer2.data(), vPwlLayer1.data(), gwLayer2.data());
+    xt::xtensor<double, 2> gvPwlLayer1(xt::zeros_like(vPwlLayer1));
+    Common::gemmNN(nMiniBatch, nLayer1, nLayer2, gvLayer2.data(), wLayer2.data(), gvPwlLayer1.data());
     xt::xtensor<double, 2> gvLayer1(gvPwlLayer1 * (leak + (xt::abs(vLayer1) < 1.0)));
     xt::xtensor<double, 1> gbLayer1(xt::sum(gvLayer1, 0));
-    xt::xtensor<double, 2> gwLayer1(xt::empty_like(wLayer1));
-    for (int i{}; i < nLayer1; ++i)
-      for (int j{}; j < nFeatures; ++j)
-        gwLayer1(i, j) = xt::sum(xt::view(gvLayer1, xt::all(), i) * xt::view(batchInput, xt::all(), j))();
+    xt::xtensor<double, 2> gwLayer1(xt::zeros_like(wLayer1));
+    Common::gemmTN(nLayer1, nFeatures, nMiniBatch, gvLayer1.data(), batchInput.data(), gwLayer1.data());
 
     // Adam
+    isPrepared = false;
     mCorrector *= mRate;
     mwLayer1 = mRate * mwLayer1 + (1 - mRate) * gwLayer1;
     mbLayer1 = mRate * mbLayer1 + (1 - mRate) * gbLayer1;
@@ -0,0 +1,44 @@
+#ifndef _PACER_H_
+#define _PACER_H_
+#include <algorithm>
+#include <chrono>
+
+namespace Common {
+  // Fills a wall-clock budget with steps whose cost depends on a slot, such as the optimizer stage.
+  // Steps run in batches sized from a running estimate of the per-step cost of the current slot, halving the
+  // remaining budget each time, so the clock is read a few times per call and the budget is overshot by about one step.
+  template<int nSlots>
+  class Pacer {
+    static constexpr int maxBatch{1 << 20};
+    static constexpr double smoothing{0.3};
+    double cost[nSlots]{};
+  public:
+    // Runs at least one step. Returns the number of steps taken.
+    template<class Step, class GetSlot>
+    int run(double seconds, Step step, GetSlot getSlot) {
+      using Clock = std::chrono::steady_clock;
+      auto start(Clock::now()), last(start);
+      int result{};
+      while (true) {
+        int slot(getSlot());
+        double remaining(seconds - std::chrono::duration<double>(last - start).count());
+        int batch(cost[slot] > 0.0 ? static_cast<int>(std::clamp(remaining * 0.5 / cost[slot], 1.0, double(maxBatch))) : 1);
+        for (int i{}; i < batch; ++i)
+          step();
+        result += batch;
+        auto now(Clock::now());
+        double perStep(std::chrono::duration<double>(now - last).count() / batch);
+        cost[slot] = cost[slot] > 0.0 ? cost[slot] + smoothing * (perStep - cost[slot]) : perStep;
+        last = now;
+        double left(seconds - std::chrono::duration<double>(now - start).count());
+        if (left < 0.5 * cost[getSlot()])
+          return result;
+      }
+    }
+
+    // Seconds per step in a slot, or zero before its first step.
+    double getCost(int slot) const { return cost[slot]; }
+  };
+}
+
+#endif
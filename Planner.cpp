@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <stdexcept>
+#include "Planner.h"
+
+namespace Planner {
+  namespace {
+    using Common::Json;
+
+    // Cooler names in enum order; active coolers have the prefix "Active ".
+    const char *fissionNames[] {
+      "Water", "Redstone", "Quartz", "Gold", "Glowstone", "Lapis", "Diamond", "Helium",
+      "Enderium", "Cryotheum", "Iron", "Emerald", "Copper", "Tin", "Magnesium"
+    };
+
+    // Names up to the shield in enum order, as the web UI's tileSaveNames.
+    const char *overhaulNames[] {
+      "Water", "Iron", "Redstone", "Quartz", "Obsidian", "NetherBrick", "Glowstone", "Lapis", "Gold", "Prismarine",
+      "Slime", "EndStone", "Purpur", "Diamond", "Emerald", "Copper", "Tin", "Lead", "Boron", "Lithium", "Magnesium",
+      "Manganese", "Aluminum", "Silver", "Fluorite", "Villiaumite", "Carobbiite", "Arsenic", "Nitrogen", "Helium",
+      "Enderium", "Cryotheum", "Graphite", "Beryllium", "HeavyWater", "Beryllium-Carbon", "Lead-Steel", "Boron-Silver"
+    };
+
+    const char *sourceNames[] { "Cf-252", "Po-Be", "Ra-Be" };
+
+    State makeState(const Json &dimensions, int air) {
+      int sizeX(dimensions["Y"].asInt()), sizeY(dimensions["Z"].asInt()), sizeZ(dimensions["X"].asInt());
+      if (sizeX <= 0 || sizeY <= 0 || sizeZ <= 0)
+        throw std::runtime_error("planner: bad interior dimensions");
+      State result(xt::empty<int>({sizeX, sizeY, sizeZ}));
+      result.fill(air);
+      return result;
+    }
+
+    void place(State &state, const Json &coords, int tile) {
+      for (auto &coord : coords.asArray()) {
+        int x(coord["Y"].asInt() - 1), y(coord["Z"].asInt() - 1), z(coord["X"].asInt() - 1);
+        auto &shape(state.shape());
+        if (x < 0 || y < 0 || z < 0 || x >= static_cast<int>(shape[0])
+          || y >= static_cast<int>(shape[1]) || z >= static_cast<int>(shape[2]))
+          throw std::runtime_error("planner: block outside the interior");
+        state(x, y, z) = tile;
+      }
+    }
+
+    int getFissionTile(const std::string &name) {
+      if (name == "FuelCell")
+        return Fission::Cell;
+      if (name == "Graphite")
+        return Fission::Moderator;
+      const std::string active("Active ");
+      bool isActive(!name.compare(0, active.size(), active));
+      std::string cooler(isActive ? name.substr(active.size()) : name);
+      for (int i{}; i < Fission::Active; ++i)
+        if (cooler == fissionNames[i])
+          return isActive ? Fission::Active + i : i;
+      throw std::runtime_error("planner: unknown block \"" + name + "\"");
+    }
+  }
+
+  State importFission(const Json &json) {
+    State result(makeState(json["InteriorDimensions"], Fission::Air));
+    for (auto &[name, coords] : json["CompressedReactor"].asObject())
+      place(result, coords, getFissionTile(name));
+    return result;
+  }
+
+  State importOverhaul(const Json &json, const OverhaulFission::Settings &settings, const std::vector<std::string> &fuelNames) {
+    using namespace OverhaulFission;
+    if (!fuelNames.empty() && fuelNames.size() != settings.fuels.size())
+      throw std::runtime_error("planner: need a name for each fuel");
+    auto &data(json["Data"]);
+    State result(makeState(data["InteriorDimensions"], Tiles::Air));
+    auto placeNamed([&](const char *category, int first, int last) {
+      const Json *blocks(data.find(category));
+      if (!blocks)
+        return;
+      for (auto &[name, coords] : blocks->asObject()) {
+        int tile(first);
+        while (tile < last && name != overhaulNames[tile])
+          ++tile;
+        if (tile == last)
+          throw std::runtime_error("planner: unknown " + std::string(category) + " \"" + name + "\"");
+        place(result, coords, tile);
+      }
+    });
+    placeNamed("HeatSinks", Tiles::Wt, Tiles::M0);
+    placeNamed("Moderators", Tiles::M0, Tiles::R0);
+    placeNamed("Reflectors", Tiles::R0, Tiles::Shield);
+    placeNamed("NeutronShields", Tiles::Shield, Tiles::Irradiator);
+    // Irradiators are named after their recipe, which doesn't matter here.
+    if (const Json *irradiators = data.find("Irradiators"))
+      for (auto &[name, coords] : irradiators->asObject())
+        place(result, coords, Tiles::Irradiator);
+    if (const Json *conductors = data.find("Conductors"))
+      place(result, *conductors, Tiles::Conductor);
+    if (const Json *cells = data.find("FuelCells")) {
+      std::vector<std::string> names(fuelNames);
+      for (auto &[key, coords] : cells->asObject()) {
+        // "<fuel>;<primed>;<source>", where the source is None, Self or one of sourceNames.
+        auto fuelEnd(key.find(';'));
+        if (fuelEnd == std::string::npos)
+          throw std::runtime_error("planner: bad fuel cell \"" + key + "\"");
+        std::string fuelName(key.substr(0, fuelEnd)), sourceName(key.substr(key.rfind(';') + 1));
+        auto it(std::find(names.begin(), names.end(), fuelName));
+        if (it == names.end()) {
+          if (!fuelNames.empty() || names.size() == settings.fuels.size())
+            throw std::runtime_error("planner: unknown fuel \"" + fuelName + "\"");
+          it = names.insert(names.end(), fuelName);
+        }
+        int fuel(static_cast<int>(it - names.begin())), source{};
+        while (source < 3 && sourceName != sourceNames[source])
+          ++source;
+        if (source < 3)
+          ++source;
+        else if (sourceName == "None" || sourceName == "Self")
+          source = 0;
+        else
+          throw std::runtime_error("planner: unknown neutron source \"" + sourceName + "\"");
+        if (source && settings.fuels[fuel].selfPriming)
+          throw std::runtime_error("planner: self-priming fuel \"" + fuelName + "\" with a neutron source");
+        // Cell types are laid out as in Settings::compute.
+        int cell(source);
+        for (int i{}; i < fuel; ++i)
+          cell += settings.fuels[i].selfPriming ? 1 : 4;
+        place(result, coords, Tiles::C0 + cell);
+      }
+    }
+    return result;
+  }
+}
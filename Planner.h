@@ -0,0 +1,22 @@
+#ifndef _PLANNER_H_
+#define _PLANNER_H_
+#include <string>
+#include <vector>
+#include "Json.h"
+#include "Fission.h"
+#include "OverhaulFission.h"
+
+// Designs saved in the format of Hellrage's reactor planner, which the web UI's save links write.
+// The planner's X, Y and Z are our z, x and y, counted from 1. Errors throw std::runtime_error.
+namespace Planner {
+  using State = xt::xtensor<int, 3>;
+
+  // Save version 1, with "CompressedReactor".
+  State importFission(const Common::Json &json);
+  // Save version 2, with "Data". Cells name their fuel, which is looked up in fuelNames, in the order of
+  //   settings.fuels; if fuelNames is empty, fuels are matched in the order their names first appear.
+  State importOverhaul(const Common::Json &json, const OverhaulFission::Settings &settings,
+    const std::vector<std::string> &fuelNames = {});
+}
+
+#endif
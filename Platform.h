@@ -0,0 +1,18 @@
+#ifndef _PLATFORM_H_
+#define _PLATFORM_H_
+
+// The web build runs on the browser's main thread unless it is compiled with -pthread.
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define FISSION_THREADS 1
+#else
+#define FISSION_THREADS 0
+#endif
+
+// Memory-mapped files are used where POSIX mmap is available; other builds keep everything in RAM.
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(__EMSCRIPTEN__)
+#define FISSION_MMAP 1
+#else
+#define FISSION_MMAP 0
+#endif
+
+#endif
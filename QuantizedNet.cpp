@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cmath>
+#include "QuantizedNet.h"
+
+namespace Common {
+  namespace {
+    constexpr std::int32_t one(1 << QuantizedNet::activationBits);
+
+    // Rounding adds at most 1/2 per weight, so a row quantized to this budget has magnitudes summing below 2^16,
+    //   and its dot product with int16 inputs of magnitude up to 2^15 stays below 2^31.
+    double getRowBudget(int nInputs) {
+      return (INT32_MAX >> 15) - nInputs;
+    }
+
+    std::int16_t saturate(std::int64_t x) {
+      return static_cast<std::int16_t>(std::clamp<std::int64_t>(x, INT16_MIN, INT16_MAX));
+    }
+
+    // Splits a positive real multiplier into a Q31 mantissa and a right shift.
+    void splitMultiplier(double x, std::int32_t &multiplier, int &shift) {
+      int exponent;
+      double mantissa(std::frexp(x, &exponent));
+      std::int64_t q(std::llround(mantissa * (1ll << 31)));
+      if (q == (1ll << 31)) {
+        q /= 2;
+        ++exponent;
+      }
+      multiplier = static_cast<std::int32_t>(q);
+      shift = 31 - exponent;
+    }
+
+    std::int64_t roundingShift(std::int64_t x, int shift) {
+      // Results are clamped to int32 by the caller, so a left shift only needs to preserve saturation.
+      if (shift <= 0)
+        return std::clamp<std::int64_t>(x, INT32_MIN, INT32_MAX) << std::min(-shift, 31);
+      if (shift >= 63)
+        return 0;
+      return (x + (1ll << (shift - 1))) >> shift;
+    }
+
+    std::int32_t dot(int n, const std::int16_t *a, const std::int16_t *b) {
+      std::int32_t result{};
+      for (int i{}; i < n; ++i)
+        result += static_cast<std::int32_t>(a[i]) * b[i];
+      return result;
+    }
+  }
+
+  void QuantizedNet::Layer::quantize(const double *weights, const double *biases, int nInputs, int nOutputs, double inputScale) {
+    this->nInputs = nInputs;
+    this->nOutputs = nOutputs;
+    this->weights.resize(static_cast<std::size_t>(nInputs) * nOutputs);
+    this->biases.resize(nOutputs);
+    multipliers.resize(nOutputs);
+    shifts.resize(nOutputs);
+    for (int i{}; i < nOutputs; ++i) {
+      const double *row(weights + static_cast<std::size_t>(i) * nInputs);
+      double norm{}, maxAbs{};
+      for (int j{}; j < nInputs; ++j) {
+        norm += std::abs(row[j]);
+        maxAbs = std::max(maxAbs, std::abs(row[j]));
+      }
+      double scale(norm > 0.0 ? std::min(getRowBudget(nInputs) / norm, INT16_MAX / maxAbs) : 1.0);
+      for (int j{}; j < nInputs; ++j)
+        this->weights[static_cast<std::size_t>(i) * nInputs + j] = saturate(std::llround(row[j] * scale));
+      // Pre-activations are produced with activationBits fractional bits.
+      splitMultiplier(one / (scale * inputScale), multipliers[i], shifts[i]);
+      this->biases[i] = static_cast<std::int32_t>(std::llround(biases[i] * one));
+    }
+  }
+
+  void QuantizedNet::Layer::forward(const std::int16_t *input, std::int32_t leak, std::int32_t *acc, std::int16_t *output) const {
+    for (int i{}; i < nOutputs; ++i)
+      acc[i] = dot(nInputs, weights.data() + static_cast<std::size_t>(i) * nInputs, input);
+    activate(acc, 0, leak, output);
+  }
+
+  void QuantizedNet::Layer::activate(const std::int32_t *acc, int inputShift, std::int32_t leak, std::int16_t *output) const {
+    for (int i{}; i < nOutputs; ++i) {
+      std::int64_t v(biases[i] + roundingShift(static_cast<std::int64_t>(acc[i]) * multipliers[i], shifts[i] + inputShift));
+      // Anything this far out saturates after the activation anyway; clamping keeps v * leak in range.
+      v = std::clamp<std::int64_t>(v, INT32_MIN, INT32_MAX);
+      // leak * v + clip(v, -1, 1) with leak in Q16.
+      std::int64_t a(roundingShift(v * leak, 16) + std::clamp<std::int64_t>(v, -one, one));
+      output[i] = saturate(a);
+    }
+  }
+
+  void QuantizedNet::quantize(int nFeatures, int nLayer1, int nLayer2,
+    const double *wLayer1, const double *bLayer1,
+    const double *wLayer2, const double *bLayer2,
+    const double *wOutput, double bOutput, double leak) {
+    // Layer 1 receives features with a per-call power-of-two scale; that exponent is folded into the shift at inference time.
+    layer1.quantize(wLayer1, bLayer1, nFeatures, nLayer1, 1.0);
+    layer2.quantize(wLayer2, bLayer2, nLayer1, nLayer2, one);
+    wLayer1T.resize(layer1.weights.size());
+    for (int i{}; i < nLayer1; ++i)
+      for (int j{}; j < nFeatures; ++j)
+        wLayer1T[static_cast<std::size_t>(j) * nLayer1 + i] = layer1.weights[static_cast<std::size_t>(i) * nFeatures + j];
+    double norm{}, maxAbs{};
+    for (int i{}; i < nLayer2; ++i) {
+      norm += std::abs(wOutput[i]);
+      maxAbs = std::max(maxAbs, std::abs(wOutput[i]));
+    }
+    outputScale = norm > 0.0 ? std::min(getRowBudget(nLayer2) / norm, INT16_MAX / maxAbs) : 1.0;
+    this->wOutput.resize(nLayer2);
+    for (int i{}; i < nLayer2; ++i)
+      this->wOutput[i] = saturate(std::llround(wOutput[i] * outputScale));
+    this->bOutput = bOutput;
+    this->leak = static_cast<std::int32_t>(std::llround(leak * 65536.0));
+    vAccumulator.resize(std::max(nLayer1, nLayer2));
+    vLayer1.resize(nLayer1);
+    vLayer2.resize(nLayer2);
+  }
+
+  double QuantizedNet::infer(int nNonZeros, const int *indices, const double *values) const {
+    // Scale the features by 2^inputBits so that the largest one still fits in int16.
+    double maxAbs{};
+    for (int p{}; p < nNonZeros; ++p)
+      maxAbs = std::max(maxAbs, std::abs(values[p]));
+    int exponent{};
+    if (maxAbs > 0.0)
+      std::frexp(maxAbs, &exponent);
+    int inputBits(std::min(30, 15 - exponent));
+    int nLayer1(layer1.nOutputs);
+    std::fill(vAccumulator.begin(), vAccumulator.begin() + nLayer1, 0);
+    for (int p{}; p < nNonZeros; ++p) {
+      std::int32_t x(saturate(std::llround(std::ldexp(values[p], inputBits))));
+      const std::int16_t *__restrict column(wLayer1T.data() + static_cast<std::size_t>(indices[p]) * nLayer1);
+      std::int32_t *__restrict acc(vAccumulator.data());
+      for (int i{}; i < nLayer1; ++i)
+        acc[i] += column[i] * x;
+    }
+    layer1.activate(vAccumulator.data(), inputBits, leak, vLayer1.data());
+    layer2.forward(vLayer1.data(), leak, vAccumulator.data(), vLayer2.data());
+    std::int32_t acc(dot(layer2.nOutputs, wOutput.data(), vLayer2.data()));
+    return bOutput + acc / (outputScale * one);
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef _QUANTIZED_NET_H_
+#define _QUANTIZED_NET_H_
+#include <cstdint>
+#include <vector>
+
+namespace Common {
+  // Inference-only fixed-point copy of a two-hidden-layer network with the activation leak * v + clip(v, -1, 1).
+  // Weights are int16 with a per-row scale chosen so that the sum of the row's rounded magnitudes stays below 2^16.
+  // As activations are saturated to int16, of magnitude at most 2^15, every dot product fits in an int32 accumulator.
+  class QuantizedNet {
+    struct Layer {
+      int nInputs, nOutputs;
+      std::vector<std::int16_t> weights;
+      std::vector<std::int32_t> biases, multipliers;
+      std::vector<int> shifts;
+      void quantize(const double *weights, const double *biases, int nInputs, int nOutputs, double inputScale);
+      void forward(const std::int16_t *input, std::int32_t leak, std::int32_t *acc, std::int16_t *output) const;
+      void activate(const std::int32_t *acc, int inputShift, std::int32_t leak, std::int16_t *output) const;
+    };
+    Layer layer1, layer2;
+    // Layer 1 weights stored per input feature, for accumulating only the columns of non-zero features.
+    std::vector<std::int16_t> wLayer1T;
+    std::vector<std::int16_t> wOutput;
+    double outputScale, bOutput;
+    std::int32_t leak;
+    mutable std::vector<std::int32_t> vAccumulator;
+    mutable std::vector<std::int16_t> vLayer1, vLayer2;
+  public:
+    // Activations use activationBits fractional bits, so they saturate at +-2^(15 - activationBits).
+    static constexpr int activationBits{11};
+    void quantize(int nFeatures, int nLayer1, int nLayer2,
+      const double *wLayer1, const double *bLayer1,
+      const double *wLayer2, const double *bLayer2,
+      const double *wOutput, double bOutput, double leak);
+    // Evaluates one sample given as its non-zero features.
+    double infer(int nNonZeros, const int *indices, const double *values) const;
+  };
+}
+
+#endif
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cstring>
+#include "Hash.h"
+#include "Platform.h"
+#include "ReplayPool.h"
+#if FISSION_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Common {
+  namespace {
+    constexpr char fileMagic[8]{'F', 'O', 'P', 'O', 'O', 'L', '\0', '\0'};
+    constexpr std::uint32_t fileVersion(2);
+    // The records start on a page boundary.
+    constexpr std::size_t headerBytes(4096);
+  }
+
+  struct ReplayPool::FileHeader {
+    char magic[8];
+    std::uint32_t version;
+    // Only finishTrajectory advances size and writePos, so rows whose target was never set sit past them.
+    // nPending counts the rows written since then, from writePos onwards.
+    std::int32_t nFeatures, capacity, size, writePos, nPending;
+    std::uint64_t settingsHash;
+  };
+
+  void ReplayPool::initialize(int nFeatures, int capacity, bool prioritized, bool deduplicated) {
+    closeFile();
+    this->nFeatures = nFeatures;
+    this->capacity = capacity;
+    this->prioritized = prioritized;
+    this->deduplicated = deduplicated;
+    nRows = 0;
+    size = 0;
+    writePos = 0;
+    records = nullptr;
+    storage.clear();
+    trajectory.clear();
+    rowTrajectory.clear();
+    trajectoryId = 0;
+    hashes.clear();
+    rowOfHash.clear();
+    tree.clear();
+    nLeaves = 0;
+    maxPriority = 1.0;
+  }
+
+  void ReplayPool::grow() {
+    nRows = std::min(capacity, std::max(1024, nRows * 2));
+    // A mapped file already spans the full capacity; only the bookkeeping grows.
+    if (!header) {
+      storage.resize(nRows * getStride());
+      records = storage.data();
+    }
+    rowTrajectory.resize(nRows, -1);
+    if (deduplicated)
+      hashes.resize(nRows);
+    if (prioritized) {
+      int oldLeaves(nLeaves);
+      nLeaves = 1;
+      while (nLeaves < nRows)
+        nLeaves *= 2;
+      std::vector<double> newTree(nLeaves * 2);
+      if (oldLeaves)
+        std::copy(tree.begin() + oldLeaves, tree.begin() + oldLeaves + size, newTree.begin() + nLeaves);
+      for (int i(nLeaves - 1); i; --i)
+        newTree[i] = newTree[i * 2] + newTree[i * 2 + 1];
+      tree.swap(newTree);
+    }
+  }
+
+  void ReplayPool::closeFile() {
+#if FISSION_MMAP
+    if (!header)
+      return;
+    munmap(header, mappedBytes);
+    header = nullptr;
+    records = nullptr;
+    mappedBytes = 0;
+#endif
+  }
+
+  bool ReplayPool::openFile(const std::string &path, std::uint64_t settingsHash) {
+#if FISSION_MMAP
+    std::size_t bytes(headerBytes + static_cast<std::size_t>(capacity) * getStride() * sizeof(float));
+    int fd(open(path.c_str(), O_RDWR | O_CREAT, 0644));
+    if (fd < 0)
+      return false;
+    struct stat st;
+    bool reuse(!fstat(fd, &st) && static_cast<std::size_t>(st.st_size) == bytes);
+    // Truncating first zeroes a stale file; the records are allocated sparsely and paged in on demand.
+    if (!reuse && (ftruncate(fd, 0) || ftruncate(fd, bytes))) {
+      close(fd);
+      return false;
+    }
+    void *mapped(mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    if (mapped == MAP_FAILED)
+      return false;
+    // Sampling touches rows at random, so readahead would only waste memory.
+    madvise(static_cast<char *>(mapped) + headerBytes, bytes - headerBytes, MADV_RANDOM);
+
+    int oldFeatures(nFeatures), oldCapacity(capacity);
+    initialize(oldFeatures, oldCapacity, prioritized, deduplicated);
+    header = static_cast<FileHeader *>(mapped);
+    mappedBytes = bytes;
+    records = reinterpret_cast<float *>(static_cast<char *>(mapped) + headerBytes);
+    reuse = reuse && !std::memcmp(header->magic, fileMagic, sizeof(fileMagic))
+      && header->version == fileVersion && header->settingsHash == settingsHash
+      && header->nFeatures == nFeatures && header->capacity == capacity
+      && header->size >= 0 && header->size <= capacity
+      && header->writePos >= 0 && header->writePos <= header->size && header->nPending >= 0;
+    if (!reuse) {
+      std::memcpy(header->magic, fileMagic, sizeof(fileMagic));
+      header->version = fileVersion;
+      header->nFeatures = nFeatures;
+      header->capacity = capacity;
+      header->size = 0;
+      header->writePos = 0;
+      header->nPending = 0;
+      header->settingsHash = settingsHash;
+      return true;
+    }
+
+    // Drop the unfinished trajectory of the previous run. Once the ring has wrapped its rows overwrote committed ones,
+    // so those holes are filled with the last committed rows.
+    std::vector<int> holes;
+    for (int i{}; i < std::min(header->nPending, capacity); ++i) {
+      int row((header->writePos + i) % capacity);
+      if (row < header->size)
+        holes.emplace_back(row);
+    }
+    std::sort(holes.begin(), holes.end());
+    int end(header->size);
+    for (std::size_t lo{}, hi(holes.size()); lo < hi;) {
+      if (holes[hi - 1] == end - 1) {
+        --hi;
+      } else {
+        std::memcpy(records + holes[lo] * getStride(), getInput(end - 1), getStride() * sizeof(float));
+        ++lo;
+      }
+      --end;
+    }
+    if (!holes.empty()) {
+      header->size = end;
+      header->writePos = end;
+    }
+    header->nPending = 0;
+
+    // Rebuild the in-memory indexes over the rows left by the previous run.
+    while (nRows < header->size)
+      grow();
+    size = header->size;
+    writePos = header->writePos;
+    for (int i{}; i < size; ++i) {
+      if (deduplicated) {
+        hashes[i] = hashRow(getInput(i));
+        rowOfHash[hashes[i]] = i;
+      }
+      if (prioritized)
+        tree[i + nLeaves] = maxPriority;
+    }
+    if (prioritized)
+      for (int i(nLeaves - 1); i > 0; --i)
+        tree[i] = tree[i * 2] + tree[i * 2 + 1];
+    return true;
+#else
+    static_cast<void>(path);
+    static_cast<void>(settingsHash);
+    return false;
+#endif
+  }
+
+  std::uint64_t ReplayPool::hashRow(const float *row) const {
+    // The features are produced deterministically, so bitwise equality is the right notion.
+    Hasher hasher;
+    hasher.addBytes(row, nFeatures * sizeof(float));
+    return hasher.get();
+  }
+
+  void ReplayPool::setPriority(int row, double priority) {
+    int node(row + nLeaves);
+    tree[node] = priority;
+    for (node /= 2; node; node /= 2)
+      tree[node] = tree[node * 2] + tree[node * 2 + 1];
+  }
+
+  void ReplayPool::newTrajectory() {
+    trajectory.clear();
+    ++trajectoryId;
+  }
+
+  void ReplayPool::append(const double *features) {
+    ++nAppends;
+    if (writePos == nRows)
+      grow();
+    float *row(records + writePos * getStride());
+    if (deduplicated) {
+      // A repeated state joins the current trajectory through its existing row instead of taking a new one.
+      scratch.assign(features, features + nFeatures);
+      std::uint64_t hash(hashRow(scratch.data()));
+      auto it(rowOfHash.find(hash));
+      if (it != rowOfHash.end() && !std::memcmp(getInput(it->second), scratch.data(), nFeatures * sizeof(float))) {
+        ++nDuplicates;
+        int existing(it->second);
+        if (rowTrajectory[existing] != trajectoryId) {
+          rowTrajectory[existing] = trajectoryId;
+          trajectory.emplace_back(existing);
+        }
+        if (prioritized)
+          setPriority(existing, maxPriority);
+        return;
+      }
+      if (writePos < size) {
+        auto evicted(rowOfHash.find(hashes[writePos]));
+        if (evicted != rowOfHash.end() && evicted->second == writePos)
+          rowOfHash.erase(evicted);
+      }
+      rowOfHash[hash] = writePos;
+      hashes[writePos] = hash;
+    }
+    if (header)
+      ++header->nPending;
+    std::copy(features, features + nFeatures, row);
+    row[nFeatures] = 0.0f;
+    if (rowTrajectory[writePos] != trajectoryId) {
+      rowTrajectory[writePos] = trajectoryId;
+      trajectory.emplace_back(writePos);
+    }
+    if (prioritized)
+      setPriority(writePos, maxPriority);
+    size = std::max(size, writePos + 1);
+    if (++writePos == capacity)
+      writePos = 0;
+  }
+
+  void ReplayPool::finishTrajectory(double target) {
+    for (int row : trajectory)
+      records[row * getStride() + nFeatures] = static_cast<float>(target);
+    if (header) {
+      header->size = size;
+      header->writePos = writePos;
+      header->nPending = 0;
+    }
+  }
+
+  int ReplayPool::sample(std::mt19937 &rng) const {
+    if (!prioritized)
+      return std::uniform_int_distribution<>(0, size - 1)(rng);
+    double x(std::uniform_real_distribution<>(0.0, tree[1])(rng));
+    int node(1);
+    while (node < nLeaves) {
+      node *= 2;
+      if (x >= tree[node]) {
+        x -= tree[node];
+        ++node;
+      }
+    }
+    // Rounding can walk past the last stored row, whose leaves are all zero.
+    return std::min(node - nLeaves, size - 1);
+  }
+
+  double ReplayPool::getProbability(int row) const {
+    if (!prioritized)
+      return 1.0 / size;
+    return tree[row + nLeaves] / tree[1];
+  }
+
+  void ReplayPool::updatePriority(int row, double priority) {
+    if (!prioritized)
+      return;
+    maxPriority = std::max(maxPriority, priority);
+    setPriority(row, priority);
+  }
+}
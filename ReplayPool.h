@@ -0,0 +1,69 @@
+#ifndef _REPLAY_POOL_H_
+#define _REPLAY_POOL_H_
+#include <cstdint>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+  // Ring buffer of fixed-size (features, target) float32 records.
+  // Storage grows geometrically up to the capacity so that small runs don't reserve the whole pool upfront.
+  // Optionally, identical rows are stored once and rows are sampled in proportion to a priority kept in a sum-tree.
+  // The records may live in a memory-mapped file instead of RAM; see openFile.
+  class ReplayPool {
+    struct FileHeader;
+    int nFeatures, capacity, nRows;
+    int size, writePos;
+    bool prioritized, deduplicated;
+    // nFeatures inputs followed by the target.
+    float *records{};
+    std::vector<float> storage, scratch;
+    FileHeader *header{};
+    std::size_t mappedBytes{};
+    // Rows of the current trajectory; a row is listed once even if it was visited several times.
+    std::vector<int> trajectory;
+    std::vector<int> rowTrajectory;
+    int trajectoryId;
+    std::vector<std::uint64_t> hashes;
+    std::unordered_map<std::uint64_t, int> rowOfHash;
+    // Sum-tree over the rows: leaves start at nLeaves and node i holds the sum of nodes 2i and 2i + 1.
+    std::vector<double> tree;
+    int nLeaves;
+    double maxPriority;
+    long long nAppends{}, nDuplicates{};
+    std::size_t getStride() const { return static_cast<std::size_t>(nFeatures) + 1; }
+    void grow();
+    std::uint64_t hashRow(const float *row) const;
+    void setPriority(int row, double priority);
+    void closeFile();
+  public:
+    ReplayPool() = default;
+    ReplayPool(const ReplayPool &) = delete;
+    ReplayPool &operator=(const ReplayPool &) = delete;
+    ~ReplayPool() { closeFile(); }
+    void initialize(int nFeatures, int capacity, bool prioritized = false, bool deduplicated = false);
+    // Moves the records to a memory-mapped file sized for the full capacity, dropping the rows held so far.
+    // A file left by a run with the same settingsHash and layout is picked up at its last finished trajectory; any other file is overwritten.
+    // Returns false, leaving the pool in RAM, where mapping isn't available or fails.
+    bool openFile(const std::string &path, std::uint64_t settingsHash);
+    void append(const double *features);
+    void newTrajectory();
+    void finishTrajectory(double target);
+    int getSize() const { return size; }
+    int getTrajectoryLength() const { return static_cast<int>(trajectory.size()); }
+    long long getNAppends() const { return nAppends; }
+    // Appends that matched a stored row; always zero without deduplication.
+    long long getNDuplicates() const { return nDuplicates; }
+    const float *getInput(int i) const { return records + i * getStride(); }
+    float getTarget(int i) const { return records[i * getStride() + nFeatures]; }
+    // Draws a row, uniformly or in proportion to its priority.
+    int sample(std::mt19937 &rng) const;
+    // Probability of sample() returning the row, for importance-sampling corrections.
+    double getProbability(int row) const;
+    // No-op unless prioritized. New rows get the largest priority seen so far.
+    void updatePriority(int row, double priority);
+  };
+}
+
+#endif
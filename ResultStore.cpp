@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "ResultStore.h"
+
+namespace Common {
+  namespace {
+    constexpr char magic[8] { 'F', 'O', 'R', 'E', 'S', 'U', 'L', '1' };
+
+    // Record layout after its uint32 byte count: key, mode, fitness, shape, nBits, summary length, summary, packed state.
+    class Writer {
+      std::vector<std::uint8_t> &out;
+    public:
+      explicit Writer(std::vector<std::uint8_t> &out) :out(out) {}
+      template<class T> void put(const T &x) {
+        auto bytes(reinterpret_cast<const std::uint8_t *>(&x));
+        out.insert(out.end(), bytes, bytes + sizeof(x));
+      }
+      void put(const void *data, std::size_t n) {
+        auto bytes(static_cast<const std::uint8_t *>(data));
+        out.insert(out.end(), bytes, bytes + n);
+      }
+    };
+
+    class Reader {
+      const std::uint8_t *data, *end;
+    public:
+      Reader(const std::uint8_t *data, std::size_t n) :data(data), end(data + n) {}
+      template<class T> bool get(T &x) {
+        if (end - data < static_cast<std::ptrdiff_t>(sizeof(x)))
+          return false;
+        std::memcpy(&x, data, sizeof(x));
+        data += sizeof(x);
+        return true;
+      }
+      const std::uint8_t *take(std::size_t n) {
+        if (static_cast<std::size_t>(end - data) < n)
+          return nullptr;
+        data += n;
+        return data - n;
+      }
+    };
+
+    int getBitWidth(const std::vector<int> &values) {
+      int max(values.empty() ? 0 : *std::max_element(values.begin(), values.end()));
+      int result(1);
+      while (max >> result)
+        ++result;
+      return result;
+    }
+  }
+
+  std::vector<std::uint8_t> packBits(const std::vector<int> &values, int nBits) {
+    std::vector<std::uint8_t> result((values.size() * nBits + 7) / 8);
+    std::size_t bit{};
+    for (int value : values) {
+      for (int i{}; i < nBits; ++i, ++bit)
+        if (value >> i & 1)
+          result[bit / 8] |= 1 << bit % 8;
+    }
+    return result;
+  }
+
+  std::vector<int> unpackBits(const std::uint8_t *data, std::size_t n, int nBits) {
+    std::vector<int> result(n);
+    std::size_t bit{};
+    for (auto &value : result)
+      for (int i{}; i < nBits; ++i, ++bit)
+        value |= (data[bit / 8] >> bit % 8 & 1) << i;
+    return result;
+  }
+
+  ResultStore::ResultStore(std::string path) :path(std::move(path)), validSize() {
+    std::ifstream in(this->path, std::ios::binary);
+    if (!in)
+      return;
+    std::vector<std::uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (bytes.size() < sizeof(magic) || std::memcmp(bytes.data(), magic, sizeof(magic)))
+      throw std::runtime_error(this->path + " is not a result store");
+    validSize = sizeof(magic);
+    Reader file(bytes.data() + sizeof(magic), bytes.size() - sizeof(magic));
+    std::uint32_t length;
+    while (file.get(length)) {
+      const std::uint8_t *body(file.take(length));
+      if (!body)
+        break;
+      Reader record(body, length);
+      std::uint64_t key;
+      std::int32_t mode;
+      std::uint16_t shape[3];
+      std::uint8_t nBits;
+      std::uint32_t summaryLength;
+      StoredResult result;
+      if (!record.get(key) || !record.get(mode) || !record.get(result.fitness) || !record.get(shape)
+        || !record.get(nBits) || !record.get(summaryLength))
+        break;
+      const std::uint8_t *summary(record.take(summaryLength));
+      std::size_t nTiles(std::size_t(shape[0]) * shape[1] * shape[2]);
+      const std::uint8_t *packed(record.take((nTiles * nBits + 7) / 8));
+      if (!summary || !packed)
+        break;
+      result.mode = mode;
+      std::copy(shape, shape + 3, result.shape);
+      result.summary.assign(reinterpret_cast<const char *>(summary), summaryLength);
+      result.state = unpackBits(packed, nTiles, nBits);
+      validSize = body + length - bytes.data();
+      auto it(best.find(key));
+      if (it == best.end() || result.fitness > it->second.fitness)
+        best[key] = std::move(result);
+    }
+  }
+
+  std::optional<StoredResult> ResultStore::find(std::uint64_t key, int mode) {
+    std::lock_guard lock(mutex);
+    auto it(best.find(key));
+    if (it == best.end() || it->second.mode != mode)
+      return std::nullopt;
+    return it->second;
+  }
+
+  bool ResultStore::offer(std::uint64_t key, const StoredResult &result) {
+    std::lock_guard lock(mutex);
+    auto it(best.find(key));
+    if (it != best.end() && it->second.mode == result.mode && result.fitness <= it->second.fitness)
+      return false;
+    int nBits(getBitWidth(result.state));
+    std::vector<std::uint8_t> body;
+    Writer writer(body);
+    writer.put(key);
+    writer.put(static_cast<std::int32_t>(result.mode));
+    writer.put(result.fitness);
+    for (int i : result.shape)
+      writer.put(static_cast<std::uint16_t>(i));
+    writer.put(static_cast<std::uint8_t>(nBits));
+    writer.put(static_cast<std::uint32_t>(result.summary.size()));
+    writer.put(result.summary.data(), result.summary.size());
+    auto packed(packBits(result.state, nBits));
+    writer.put(packed.data(), packed.size());
+
+    std::error_code error;
+    std::uintmax_t size(std::filesystem::file_size(path, error));
+    bool isNew(error || !size);
+    // Cuts off a torn record left by a crash, so that this one follows the last complete record.
+    std::uintmax_t end(isNew ? 0 : validSize ? std::min(size, validSize) : size);
+    if (!isNew && end < size) {
+      std::filesystem::resize_file(path, end, error);
+      if (error)
+        throw std::runtime_error("can't truncate " + path);
+    }
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    if (isNew)
+      out.write(magic, sizeof(magic));
+    auto length(static_cast<std::uint32_t>(body.size()));
+    out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+    out.write(reinterpret_cast<const char *>(body.data()), body.size());
+    out.flush();
+    if (!out)
+      throw std::runtime_error("can't write " + path);
+    validSize = (isNew ? sizeof(magic) : end) + sizeof(length) + body.size();
+    best[key] = result;
+    return true;
+  }
+}
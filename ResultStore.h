@@ -0,0 +1,44 @@
+#ifndef _RESULT_STORE_H_
+#define _RESULT_STORE_H_
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Common {
+  struct StoredResult {
+    // Tells apart designs of different game modes whose settings happen to hash alike.
+    int mode;
+    double fitness;
+    int shape[3];
+    std::vector<int> state;
+    // Evaluation figures, as compact JSON.
+    std::string summary;
+  };
+
+  // Best known design per settings hash, kept in an append-only file of records with bit-packed states.
+  // Loading replays the file and keeps the fittest record per key; a torn record at the end, left by a crash, is ignored
+  //   and cut off before the next record is appended.
+  // The file is written in the native byte order. All members are thread-safe.
+  class ResultStore {
+    std::string path;
+    std::mutex mutex;
+    std::unordered_map<std::uint64_t, StoredResult> best;
+    // Bytes of the file up to the end of the last complete record; 0 before the file exists.
+    std::uintmax_t validSize;
+  public:
+    // A missing file is an empty store; it is created on the first offer. Throws std::runtime_error on a foreign file.
+    explicit ResultStore(std::string path);
+    std::optional<StoredResult> find(std::uint64_t key, int mode);
+    // Keeps the result if it beats the stored one for the key, and returns whether it did.
+    bool offer(std::uint64_t key, const StoredResult &result);
+  };
+
+  // Packs values in [0, 2^nBits) into consecutive bit fields, least significant bit first.
+  std::vector<std::uint8_t> packBits(const std::vector<int> &values, int nBits);
+  std::vector<int> unpackBits(const std::uint8_t *data, std::size_t n, int nBits);
+}
+
+#endif
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "Scheduler.h"
+
+namespace Common {
+  namespace {
+    struct Worker {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+  }
+
+  void runWorkStealing(int nThreads, std::vector<Task> tasks, const std::function<Task()> &onIdle) {
+    // Without onIdle, workers beyond the number of tasks could never get one.
+    if (!onIdle)
+      nThreads = std::min(nThreads, static_cast<int>(tasks.size()));
+    nThreads = std::max(1, nThreads);
+    std::vector<Worker> workers(nThreads);
+    for (std::size_t i{}; i < tasks.size(); ++i)
+      workers[i % nThreads].tasks.emplace_back(std::move(tasks[i]));
+    std::atomic<std::size_t> nLive(tasks.size());
+    auto work([&](int self) {
+      Worker &own(workers[self]);
+      while (nLive) {
+        Task task;
+        {
+          std::lock_guard lock(own.mutex);
+          if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+          }
+        }
+        for (int i(1); !task && i < nThreads; ++i) {
+          Worker &victim(workers[(self + i) % nThreads]);
+          std::lock_guard lock(victim.mutex);
+          if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+          }
+        }
+        if (!task && onIdle) {
+          // Counted before asking so that the other workers don't see zero and leave while the task is being made.
+          ++nLive;
+          task = onIdle();
+          if (!task)
+            --nLive;
+        }
+        if (!task) {
+          // Everything left is running on other workers; wait for one of them to give a task back or finish.
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          continue;
+        }
+        TaskResult result(task());
+        if (result == TaskResult::Done) {
+          --nLive;
+          continue;
+        }
+        std::lock_guard lock(own.mutex);
+        if (result == TaskResult::RunNext)
+          own.tasks.emplace_front(std::move(task));
+        else
+          own.tasks.emplace_back(std::move(task));
+      }
+    });
+    std::vector<std::thread> threads;
+    for (int i(1); i < nThreads; ++i)
+      threads.emplace_back(work, i);
+    work(0);
+    for (auto &thread : threads)
+      thread.join();
+  }
+}
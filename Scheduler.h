@@ -0,0 +1,27 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+#include <functional>
+#include <vector>
+
+namespace Common {
+  // What a task wants after running one slice of its work.
+  enum class TaskResult {
+    Done,
+    // Run again soon, on the same worker if nobody steals it first.
+    RunNext,
+    // Run again after the other tasks queued on this worker.
+    RunLater
+  };
+
+  using Task = std::function<TaskResult()>;
+
+  // Runs sliced tasks on nThreads workers until all are done. Each worker owns a deque, dealt the tasks round-robin.
+  // It takes from the front of its own deque and, when that is empty, steals from the back of the others', so a worker
+  // that runs out of work picks up the tasks that were pushed back rather than the ones about to run.
+  // A worker that finds nothing to run or steal asks onIdle, if given, for a new task, which it runs like the others;
+  // onIdle may be called from several workers at once.
+  // Tasks must not throw.
+  void runWorkStealing(int nThreads, std::vector<Task> tasks, const std::function<Task()> &onIdle = {});
+}
+
+#endif
@@ -0,0 +1,28 @@
+#include <filesystem>
+#include <fstream>
+#include "Snapshot.h"
+#include "Log.h"
+
+namespace Common {
+  bool writeFileAtomically(const std::string &path, const std::function<void(std::ostream &)> &write) {
+    std::string tempPath(path + ".tmp");
+    {
+      std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+      if (out)
+        write(out);
+      out.flush();
+      if (!out) {
+        log(LogLevel::Warn, "can't write %s", tempPath.c_str());
+        return false;
+      }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+      log(LogLevel::Warn, "can't replace %s: %s", path.c_str(), error.message().c_str());
+      std::filesystem::remove(tempPath, error);
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,119 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include "Platform.h"
+#if FISSION_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace Common {
+  // Writes to a temporary file next to path and renames it over path, so readers see the old or the new file, never
+  // a partial one. Returns false and leaves path alone on failure.
+  bool writeFileAtomically(const std::string &path, const std::function<void(std::ostream &)> &write);
+
+  // Keeps a file up to date with the latest of a stream of values, serializing and writing on a background thread.
+  // submit copies the value into a pending buffer that the writer swaps with its own, so a value submitted while the
+  // disk is busy replaces the one still waiting rather than queueing behind it. The last value is written on destruction.
+  // Builds without threads write synchronously in submit.
+  template<class T>
+  class SnapshotWriter {
+    std::string path;
+    std::function<void(std::ostream &, const T &)> serialize;
+    T pending, writing;
+    bool hasPending;
+    long long nWritten, nFailed, nDropped;
+#if FISSION_THREADS
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+#endif
+
+    void writeOne() {
+      bool ok(writeFileAtomically(path, [&](std::ostream &out) { serialize(out, writing); }));
+#if FISSION_THREADS
+      std::lock_guard lock(mutex);
+#endif
+      ++(ok ? nWritten : nFailed);
+    }
+  public:
+    SnapshotWriter(std::string path, std::function<void(std::ostream &, const T &)> serialize)
+      :path(std::move(path)), serialize(std::move(serialize)), hasPending(), nWritten(), nFailed(), nDropped() {
+#if FISSION_THREADS
+      stopping = false;
+      thread = std::thread([this] {
+        std::unique_lock lock(mutex);
+        while (true) {
+          wake.wait(lock, [this] { return hasPending || stopping; });
+          if (!hasPending)
+            break;
+          std::swap(pending, writing);
+          hasPending = false;
+          lock.unlock();
+          writeOne();
+          lock.lock();
+        }
+      });
+#endif
+    }
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    ~SnapshotWriter() {
+#if FISSION_THREADS
+      {
+        std::lock_guard lock(mutex);
+        stopping = true;
+      }
+      wake.notify_one();
+      thread.join();
+#endif
+    }
+
+    void submit(const T &value) {
+#if FISSION_THREADS
+      {
+        std::lock_guard lock(mutex);
+        if (hasPending)
+          ++nDropped;
+        pending = value;
+        hasPending = true;
+      }
+      wake.notify_one();
+#else
+      writing = value;
+      writeOne();
+#endif
+    }
+
+    // Submitted values that were replaced before being written.
+    long long getNDropped() {
+#if FISSION_THREADS
+      std::lock_guard lock(mutex);
+#endif
+      return nDropped;
+    }
+
+    long long getNWritten() {
+#if FISSION_THREADS
+      std::lock_guard lock(mutex);
+#endif
+      return nWritten;
+    }
+
+    long long getNFailed() {
+#if FISSION_THREADS
+      std::lock_guard lock(mutex);
+#endif
+      return nFailed;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "Snapshot.h"
+#include "Trace.h"
+
+namespace Common {
+  std::atomic<bool> traceEnabled;
+  thread_local int traceDepth;
+  thread_local bool traceSampled;
+
+  namespace {
+    constexpr std::size_t maxTraceEvents(1 << 22);
+
+    struct TraceEvent {
+      const char *name;
+      double start, duration;
+      int thread;
+    };
+
+    struct TraceState {
+      std::mutex mutex;
+      std::vector<TraceEvent> events;
+      // steady_clock ticks at startTrace; atomic since scopes on other threads read it.
+      std::atomic<std::chrono::steady_clock::rep> origin{};
+      std::atomic<int> samplePeriod{1}, nThreads{};
+      std::atomic<long long> nDropped{};
+    };
+
+    TraceState &getState() {
+      static TraceState state;
+      return state;
+    }
+
+    thread_local unsigned nOutermostScopes;
+    thread_local int traceThread(-1);
+
+    int getTraceThread() {
+      if (traceThread < 0)
+        traceThread = getState().nThreads++;
+      return traceThread;
+    }
+  }
+
+  void startTrace(int samplePeriod) {
+    TraceState &state(getState());
+    {
+      std::lock_guard lock(state.mutex);
+      state.events.clear();
+    }
+    state.origin = std::chrono::steady_clock::now().time_since_epoch().count();
+    state.samplePeriod = std::max(1, samplePeriod);
+    state.nDropped = 0;
+    traceEnabled = true;
+  }
+
+  bool stopTrace(const std::string &path) {
+    TraceState &state(getState());
+    traceEnabled = false;
+    std::vector<TraceEvent> events;
+    {
+      std::lock_guard lock(state.mutex);
+      std::swap(events, state.events);
+    }
+    return writeFileAtomically(path, [&](std::ostream &out) {
+      out << std::fixed;
+      out.precision(3);
+      out << "{\"traceEvents\":[";
+      for (std::size_t i{}; i < events.size(); ++i) {
+        auto &event(events[i]);
+        out << (i ? ",\n" : "\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+          << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << '}';
+      }
+      out << "\n],\"displayTimeUnit\":\"ns\"}" << std::endl;
+    });
+  }
+
+  long long getNDroppedTraceEvents() {
+    return getState().nDropped;
+  }
+
+  double getTraceTime() {
+    std::chrono::steady_clock::duration origin(getState().origin.load(std::memory_order_relaxed));
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch() - origin).count();
+  }
+
+  void addTraceEvent(const char *name, double start, double end) {
+    TraceState &state(getState());
+    int thread(getTraceThread());
+    std::lock_guard lock(state.mutex);
+    if (state.events.size() >= maxTraceEvents)
+      ++state.nDropped;
+    else
+      state.events.push_back({name, start, end - start, thread});
+  }
+
+  void TraceScope::begin() {
+    if (!traceDepth)
+      traceSampled = !(nOutermostScopes++ % static_cast<unsigned>(getState().samplePeriod.load(std::memory_order_relaxed)));
+    ++traceDepth;
+    if (traceSampled)
+      start = getTraceTime();
+  }
+
+  void TraceScope::end() {
+    --traceDepth;
+    if (traceSampled)
+      addTraceEvent(name, start, getTraceTime());
+  }
+}
@@ -0,0 +1,51 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+#include <atomic>
+#include <string>
+
+namespace Common {
+  // Timeline of scoped events in the Chrome Trace Event format, for chrome://tracing or Perfetto.
+  // Tracing is process-wide and off by default; while off, a scope costs one relaxed load.
+  // To bound the overhead on long runs, each thread records only one in samplePeriod of its outermost scopes,
+  // together with everything nested in them.
+  extern std::atomic<bool> traceEnabled;
+  extern thread_local int traceDepth;
+  extern thread_local bool traceSampled;
+
+  void startTrace(int samplePeriod);
+  // Stops recording, writes the events to path and drops them. Returns false if the file can't be written.
+  bool stopTrace(const std::string &path);
+  long long getNDroppedTraceEvents();
+  // Microseconds since startTrace.
+  double getTraceTime();
+  // name must outlive the trace; string literals are the intended use.
+  void addTraceEvent(const char *name, double start, double end);
+
+  // True inside a scope that is being recorded on this thread.
+  inline bool isTraceSampled() {
+    return traceDepth && traceSampled && traceEnabled.load(std::memory_order_relaxed);
+  }
+
+  class TraceScope {
+    const char *name;
+    double start;
+    bool active;
+    void begin();
+    void end();
+  public:
+    explicit TraceScope(const char *name) :name(name), active(traceEnabled.load(std::memory_order_relaxed)) {
+      if (active)
+        begin();
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    ~TraceScope() {
+      if (active)
+        end();
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "Trainer.h"
+
+namespace Common {
+  Trainer::~Trainer() {
+    cancelled = true;
+#if FISSION_THREADS
+    if (thread.joinable())
+      thread.join();
+#endif
+  }
+
+  void Trainer::start(int nIteration, std::function<double()> iteration) {
+    nRemaining = nIteration;
+    auto body([this, iteration(std::move(iteration))] {
+      while (nRemaining > 0 && !cancelled) {
+        double loss(iteration());
+        {
+#if FISSION_THREADS
+          std::lock_guard lock(mutex);
+#endif
+          losses.emplace_back(loss);
+        }
+        --nRemaining;
+      }
+    });
+#if FISSION_THREADS
+    thread = std::thread(std::move(body));
+#else
+    body();
+#endif
+  }
+
+  bool Trainer::poll() {
+    if (nRemaining > 0)
+      return false;
+#if FISSION_THREADS
+    if (thread.joinable())
+      thread.join();
+#endif
+    return true;
+  }
+
+  void Trainer::drainLosses(std::vector<double> &out) {
+    out.clear();
+#if FISSION_THREADS
+    std::lock_guard lock(mutex);
+#endif
+    std::swap(out, losses);
+  }
+}
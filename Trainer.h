@@ -0,0 +1,34 @@
+#ifndef _TRAINER_H_
+#define _TRAINER_H_
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "Platform.h"
+#if FISSION_THREADS
+#include <mutex>
+#include <thread>
+#endif
+
+namespace Common {
+  // Runs a fixed number of training iterations on a background thread.
+  // The caller must not touch the network until poll() reports completion, which also joins the thread.
+  class Trainer {
+#if FISSION_THREADS
+    std::thread thread;
+    std::mutex mutex;
+#endif
+    std::vector<double> losses;
+    std::atomic<int> nRemaining;
+    std::atomic<bool> cancelled;
+  public:
+    static constexpr bool isAsync{FISSION_THREADS};
+    Trainer() :nRemaining(), cancelled() {}
+    ~Trainer();
+    void start(int nIteration, std::function<double()> iteration);
+    bool poll();
+    void drainLosses(std::vector<double> &out);
+    int getNRemaining() const { return nRemaining; }
+  };
+}
+
+#endif
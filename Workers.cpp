@@ -0,0 +1,77 @@
+#include "Workers.h"
+
+namespace Common {
+  WorkerGroup::WorkerGroup(int nThreads)
+#if FISSION_THREADS
+    :generation(), nBusy(), stopping(), body(), next(), n() {
+    for (int i(1); i < nThreads; ++i)
+      threads.emplace_back([this] { work(); });
+  }
+#else
+    :body(), next(), n() {}
+#endif
+
+  WorkerGroup::~WorkerGroup() {
+#if FISSION_THREADS
+    {
+      std::lock_guard lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto &thread : threads)
+      thread.join();
+#endif
+  }
+
+  int WorkerGroup::getNThreads() const {
+#if FISSION_THREADS
+    return static_cast<int>(threads.size()) + 1;
+#else
+    return 1;
+#endif
+  }
+
+  void WorkerGroup::drain() {
+    for (int i; (i = next++) < n;)
+      (*body)(i);
+  }
+
+#if FISSION_THREADS
+  void WorkerGroup::work() {
+    long long seen{};
+    std::unique_lock lock(mutex);
+    while (true) {
+      wake.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+      lock.unlock();
+      drain();
+      lock.lock();
+      if (!--nBusy)
+        done.notify_one();
+    }
+  }
+#endif
+
+  void WorkerGroup::run(int n, const std::function<void(int)> &body) {
+    this->body = &body;
+    this->n = n;
+    next = 0;
+#if FISSION_THREADS
+    if (!threads.empty()) {
+      {
+        std::lock_guard lock(mutex);
+        nBusy = static_cast<int>(threads.size());
+        ++generation;
+      }
+      wake.notify_all();
+      drain();
+      std::unique_lock lock(mutex);
+      done.wait(lock, [this] { return !nBusy; });
+      return;
+    }
+#endif
+    drain();
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef _WORKERS_H_
+#define _WORKERS_H_
+#include <atomic>
+#include <functional>
+#include <vector>
+#include "Platform.h"
+#if FISSION_THREADS
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace Common {
+  // Runs short parallel loops on threads that persist between loops, so each loop costs a wakeup rather than a spawn.
+  // Without threads the loops run on the caller.
+  class WorkerGroup {
+#if FISSION_THREADS
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    long long generation;
+    int nBusy;
+    bool stopping;
+    void work();
+#endif
+    const std::function<void(int)> *body;
+    std::atomic<int> next;
+    int n;
+    void drain();
+  public:
+    // nThreads counts the caller, which takes part in every loop.
+    explicit WorkerGroup(int nThreads);
+    ~WorkerGroup();
+    WorkerGroup(const WorkerGroup &) = delete;
+    WorkerGroup &operator=(const WorkerGroup &) = delete;
+    int getNThreads() const;
+    // Calls body(i) for each i below n, in any order and on any of the threads. Returns when all calls have returned.
+    void run(int n, const std::function<void(int)> &body);
+  };
+}
+
+#endif
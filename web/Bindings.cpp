@@ -1,6 +1,8 @@
 #include <emscripten/bind.h>
 #include "../FissionNet.h"
 #include "../OverhaulFissionNet.h"
+#include "../Log.h"
+#include "../Planner.h"
 
 static void setLimit(Fission::Settings &x, int index, int limit) {
   x.limit[index] = limit;
@@ -54,6 +56,11 @@ static double getEfficiency(const Fission::Sample &x) {
   return x.value.efficiency;
 }
 
+// Starts from a design saved for Hellrage's reactor planner.
+static Fission::Opt *fissionOptFromPlanner(const Fission::Settings &settings, bool useNet, const std::string &planner) {
+  return new Fission::Opt(settings, useNet, Planner::importFission(Common::Json::parse(planner)));
+}
+
 static emscripten::val getLossHistory(const Fission::Opt &opt) {
   auto &data(opt.getLossHistory());
   return emscripten::val(emscripten::typed_memory_view(data.size(), data.data()));
@@ -108,12 +115,89 @@ static int getIrradiatorFlux(const OverhaulFission::Sample &x) {
   return x.value.irradiatorFlux;
 }
 
+// fuelNames are the names the planner file uses for the fuels, in the order they were added.
+static OverhaulFission::Opt *overhaulOptFromPlanner(OverhaulFission::Settings &settings, const std::string &planner, emscripten::val fuelNames) {
+  std::vector<std::string> names;
+  int nNames(fuelNames["length"].as<int>());
+  for (int i{}; i < nNames; ++i)
+    names.emplace_back(fuelNames[i].as<std::string>());
+  return new OverhaulFission::Opt(settings, Planner::importOverhaul(Common::Json::parse(planner), settings, names));
+}
+
 static emscripten::val overhaulGetLossHistory(const OverhaulFission::Opt &opt) {
   auto &data(opt.getLossHistory());
   return emscripten::val(emscripten::typed_memory_view(data.size(), data.data()));
 }
 
+static emscripten::val getScreenStats(const OverhaulFission::Opt &opt) {
+  auto &stats(opt.getScreenStats());
+  auto result(emscripten::val::object());
+  result.set("nProposed", static_cast<double>(stats.nProposed));
+  result.set("nEvaluated", static_cast<double>(stats.nEvaluated));
+  result.set("nHits", static_cast<double>(stats.nHits));
+  result.set("threshold", stats.threshold);
+  return result;
+}
+
+static emscripten::val getTemperingStats(const OverhaulFission::Opt &opt) {
+  auto &stats(opt.getTemperingStats());
+  auto result(emscripten::val::object());
+  result.set("nSwapProposals", static_cast<double>(stats.nSwapProposals));
+  result.set("nSwaps", static_cast<double>(stats.nSwaps));
+  return result;
+}
+
+static emscripten::val countersToVal(const Common::Counters &counters) {
+  auto result(emscripten::val::object());
+  result.set("seconds", counters.seconds);
+  result.set("nSteps", static_cast<double>(counters.nSteps));
+  result.set("nEvaluations", static_cast<double>(counters.nEvaluations));
+  result.set("evaluationsPerSecond", counters.getEvaluationsPerSecond());
+  result.set("nProposals", static_cast<double>(counters.nProposals));
+  result.set("nAccepted", static_cast<double>(counters.nAccepted));
+  result.set("acceptanceRate", counters.getAcceptanceRate());
+  result.set("nInferences", static_cast<double>(counters.nInferences));
+  result.set("nTrainIterations", static_cast<double>(counters.nTrainIterations));
+  result.set("poolSize", counters.poolSize);
+  result.set("poolHitRate", counters.getPoolHitRate());
+  result.set("rolloutSeconds", counters.rolloutSeconds);
+  result.set("trainSeconds", counters.trainSeconds);
+  result.set("inferSeconds", counters.inferSeconds);
+  auto phases(emscripten::val::object());
+  for (int i{}; i < Common::nPhases; ++i)
+    phases.set(Common::phaseNames[i], counters.phases.seconds[i]);
+  result.set("phaseSeconds", phases);
+  result.set("nProfiledEvaluations", static_cast<double>(counters.phases.nRuns));
+  return result;
+}
+
+static emscripten::val getCounters(const Fission::Opt &opt) {
+  return countersToVal(opt.getCounters());
+}
+
+static emscripten::val overhaulGetCounters(const OverhaulFission::Opt &opt) {
+  return countersToVal(opt.getCounters());
+}
+
+static void setLogLevel(int level) {
+  Common::setLogLevel(static_cast<Common::LogLevel>(level));
+}
+
+static emscripten::val drainLog() {
+  auto result(emscripten::val::array());
+  Common::LogRecord record;
+  while (Common::popLog(record)) {
+    auto entry(emscripten::val::object());
+    entry.set("level", std::string(Common::getLogLevelName(record.level)));
+    entry.set("text", std::string(record.text));
+    result.call<void>("push", entry);
+  }
+  return result;
+}
+
 EMSCRIPTEN_BINDINGS(FissionOpt) {
+  emscripten::function("setLogLevel", &setLogLevel);
+  emscripten::function("drainLog", &drainLog);
   emscripten::class_<Fission::Settings>("FissionSettings")
     .constructor<>()
     .property("sizeX", &Fission::Settings::sizeX)
@@ -143,14 +227,19 @@ EMSCRIPTEN_BINDINGS(FissionOpt) {
     .function("getEfficiency", &getEfficiency);
   emscripten::class_<Fission::Opt>("FissionOpt")
     .constructor<const Fission::Settings&, bool>()
+    .constructor(&fissionOptFromPlanner)
     .function("stepInteractive", &Fission::Opt::stepInteractive)
+    .function("stepFor", &Fission::Opt::stepFor)
     .function("needsRedrawBest", &Fission::Opt::needsRedrawBest)
     .function("needsReplotLoss", &Fission::Opt::needsReplotLoss)
     .function("getLossHistory", &getLossHistory)
     .function("getBest", &Fission::Opt::getBest)
     .function("getNEpisode", &Fission::Opt::getNEpisode)
     .function("getNStage", &Fission::Opt::getNStage)
-    .function("getNIteration", &Fission::Opt::getNIteration);
+    .function("getNIteration", &Fission::Opt::getNIteration)
+    .function("setProfiling", &Fission::Opt::setProfiling)
+    .function("setPolish", &Fission::Opt::setPolish)
+    .function("getCounters", &getCounters);
   emscripten::class_<OverhaulFission::Settings>("OverhaulFissionSettings")
     .constructor<>()
     .property("sizeX", &OverhaulFission::Settings::sizeX)
@@ -164,7 +253,10 @@ EMSCRIPTEN_BINDINGS(FissionOpt) {
     .property("controllable", &OverhaulFission::Settings::controllable)
     .property("symX", &OverhaulFission::Settings::symX)
     .property("symY", &OverhaulFission::Settings::symY)
-    .property("symZ", &OverhaulFission::Settings::symZ);
+    .property("symZ", &OverhaulFission::Settings::symZ)
+    .property("nReplicas", &OverhaulFission::Settings::nReplicas)
+    .property("minTemperature", &OverhaulFission::Settings::minTemperature)
+    .property("maxTemperature", &OverhaulFission::Settings::maxTemperature);
   emscripten::class_<OverhaulFission::Sample>("OverhaulFissionSample")
     .function("getData", &overhaulGetData)
     .function("getShape", &overhaulGetShape)
@@ -175,12 +267,20 @@ EMSCRIPTEN_BINDINGS(FissionOpt) {
     .function("getIrradiatorFlux", &getIrradiatorFlux);
   emscripten::class_<OverhaulFission::Opt>("OverhaulFissionOpt")
     .constructor<OverhaulFission::Settings&>()
+    .constructor(&overhaulOptFromPlanner)
     .function("stepInteractive", &OverhaulFission::Opt::stepInteractive)
+    .function("stepFor", &OverhaulFission::Opt::stepFor)
     .function("needsRedrawBest", &OverhaulFission::Opt::needsRedrawBest)
     .function("needsReplotLoss", &OverhaulFission::Opt::needsReplotLoss)
     .function("getLossHistory", &overhaulGetLossHistory)
+    .function("setScreening", &OverhaulFission::Opt::setScreening)
+    .function("getScreenStats", &getScreenStats)
+    .function("setTemperingThreads", &OverhaulFission::Opt::setTemperingThreads)
+    .function("getTemperingStats", &getTemperingStats)
     .function("getBest", &OverhaulFission::Opt::getBest)
     .function("getNEpisode", &OverhaulFission::Opt::getNEpisode)
     .function("getNStage", &OverhaulFission::Opt::getNStage)
-    .function("getNIteration", &OverhaulFission::Opt::getNIteration);
+    .function("getNIteration", &OverhaulFission::Opt::getNIteration)
+    .function("setProfiling", &OverhaulFission::Opt::setProfiling)
+    .function("getCounters", &overhaulGetCounters);
 }
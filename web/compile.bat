@@ -1 +1 @@
-em++ --bind -s MODULARIZE=1 -s EXPORT_NAME=FissionOpt -s ALLOW_MEMORY_GROWTH=1 -o FissionOpt.js -std=c++17 -flto -O3 Bindings.cpp ../Fission.cpp ../OptFission.cpp ../FissionNet.cpp ../OverhaulFission.cpp ../OptOverhaulFission.cpp ../OverhaulFissionNet.cpp -I../../xtl/include -I../../xtensor/include
+em++ --bind -s MODULARIZE=1 -s EXPORT_NAME=FissionOpt -s ALLOW_MEMORY_GROWTH=1 -o FissionOpt.js -std=c++17 -flto -O3 -msimd128 Bindings.cpp ../Fission.cpp ../OptFission.cpp ../FissionNet.cpp ../OverhaulFission.cpp ../OptOverhaulFission.cpp ../OverhaulFissionNet.cpp ../ReplayPool.cpp ../Gemm.cpp ../Trainer.cpp ../Workers.cpp ../QuantizedNet.cpp ../Log.cpp ../Trace.cpp ../Snapshot.cpp ../Json.cpp ../Planner.cpp -I../../xtl/include -I../../xtensor/include
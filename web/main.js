@@ -352,9 +352,11 @@ $(() => { FissionOpt().then((FissionOpt) => {
 
   const progress = $('#progress');
   let lossElement, lossPlot;
+  // Microseconds of search per timer callback, leaving the rest of a frame to the browser.
+  const frameBudget = 12000;
   function step() {
     schedule();
-    opt.stepInteractive();
+    opt.stepFor(frameBudget);
     const nStage = opt.getNStage();
     if (nStage == -2)
       progress.text('Episode ' + opt.getNEpisode() + ', training iteration ' + opt.getNIteration());
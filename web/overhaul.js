@@ -194,6 +194,8 @@ $(() => { FissionOpt().then((FissionOpt) => {
     timeout = window.setTimeout(step, 0);
   };
 
+  // Levels follow Common::LogLevel: debug, info, warn, error, off.
+  FissionOpt.setLogLevel(1);
   const settings = new FissionOpt.OverhaulFissionSettings();
   const design = $('#design');
   const save = $('#save');
@@ -331,9 +333,13 @@ $(() => { FissionOpt().then((FissionOpt) => {
 
   const progress = $('#progress');
   let lossElement, lossPlot;
+  // Microseconds of search per timer callback, leaving the rest of a frame to the browser.
+  const frameBudget = 12000;
   function step() {
     schedule();
-    opt.stepInteractive();
+    opt.stepFor(frameBudget);
+    for (const record of FissionOpt.drainLog())
+      console.log(record.text);
     const nStage = opt.getNStage();
     if (nStage == 1)
       progress.text('Episode ' + opt.getNEpisode() + ', training iteration ' + opt.getNIteration());